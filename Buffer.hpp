@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <map>
 #include <typeindex>
@@ -31,12 +32,14 @@ public:
 	Buffer(Buffer &&other) noexcept {
 		handle = other.handle;
 		size = other.size;
+		capacity = other.capacity;
 		other.handle = 0;
 	}
 
 	Buffer &operator=(Buffer &&right) {
 		handle = right.handle;
 		size = right.size;
+		capacity = right.capacity;
 		right.handle = 0;
 
 		return *this;
@@ -54,27 +57,45 @@ public:
 	}
 
 	void BufferData(const T *data, std::size_t size, GLenum usage = GL_STATIC_DRAW) {
-		this->size = size;
+		this->size = capacity = size;
 		glBufferData(E, sizeof(T) * size, data, usage);
 	}
 
 	void BufferData(const std::vector<T> &data, GLenum usage = GL_STATIC_DRAW) {
-		size = data.size();
+		size = capacity = data.size();
 		glBufferData(E, sizeof(T) * data.size(), data.data(), usage);
 	}
 
 	template <std::size_t N>
 	void BufferData(const std::array<T, N> data, GLenum usage = GL_STATIC_DRAW) {
-		size = N;
+		size = capacity = N;
 		glBufferData(E, sizeof(T) * N, data.data(), usage);
 	}
 
 	// Allocates an _empty_ buffer of the provided size
 	void BufferData(std::size_t size, GLenum usage = GL_STATIC_DRAW) {
 		this->size = size;
+		capacity = size / sizeof(T);
 		glBufferData(E, size, nullptr, usage);
 	}
 
+	// Replaces the contents of the (bound) buffer with count elements.
+	// The storage is only reallocated when the data outgrows it, and is
+	// orphaned otherwise so that we never wait on draws still using it.
+	void Stream(const T *data, std::size_t count, GLenum usage = GL_STREAM_DRAW) {
+		if (count > capacity)
+			capacity = std::max(count, capacity * 2);
+
+		glBufferData(E, sizeof(T) * capacity, nullptr, usage);
+		glBufferSubData(E, 0, sizeof(T) * count, data);
+
+		size = count;
+	}
+
+	void Stream(const std::vector<T> &data, GLenum usage = GL_STREAM_DRAW) {
+		Stream(data.data(), data.size(), usage);
+	}
+
 	void BufferSubData(GLintptr offset, GLsizeiptr size, const void *data) {
 		glBufferSubData(E, offset * sizeof(T), size, data);
 	}
@@ -85,6 +106,19 @@ public:
 		return ret;
 	}
 
+	// Maps count elements of the (bound) buffer, starting at offset
+	const T *MapBufferRange(GLintptr offset, GLsizeiptr count, GLbitfield access = GL_MAP_READ_BIT) {
+		return static_cast<const T *>(glMapBufferRange(E, offset * sizeof(T), count * sizeof(T), access));
+	}
+
+	T *MapBufferRangeWritable(GLintptr offset, GLsizeiptr count, GLbitfield access = GL_MAP_WRITE_BIT) {
+		return static_cast<T *>(glMapBufferRange(E, offset * sizeof(T), count * sizeof(T), access));
+	}
+
+	bool UnmapBuffer() {
+		return glUnmapBuffer(E) == GL_TRUE;
+	}
+
 	inline constexpr void DrawArrays(GLenum mode, GLint first, GLsizei count) {
 		glDrawArrays(mode, first, count);
 	}
@@ -101,8 +135,11 @@ private:
 	GLuint handle = 0;
 
 	typename std::vector<T>::size_type size = 0;
+	typename std::vector<T>::size_type capacity = 0;
 };
 
 using ArrayBuffer = Buffer<GL_ARRAY_BUFFER, float>;
 using ElementBuffer = Buffer<GL_ELEMENT_ARRAY_BUFFER, unsigned short>;
+using PixelPackBuffer = Buffer<GL_PIXEL_PACK_BUFFER, uint8_t>;
+using PixelUnpackBuffer = Buffer<GL_PIXEL_UNPACK_BUFFER, uint8_t>;
 }
\ No newline at end of file
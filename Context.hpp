@@ -1,10 +1,14 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <vector>
 
 #include "Logger.hpp"
+#include "ProgramBinaryCache.hpp"
+#include "QuadMesh.hpp"
 #include "Shader.hpp"
+#include "ShaderPreprocessor.hpp"
 #include "ShaderProgram.hpp"
 
 namespace Fetcko {
@@ -21,32 +25,23 @@ public:
 	ShaderProgram &GetShaderProgram() { return currentShader->program; }
 
 	Shader *AddShader(
-		std::filesystem::path &vertex,
-		std::filesystem::path &fragment,
+		const std::filesystem::path &vertex,
+		const std::filesystem::path &fragment,
 		std::uint32_t hash
 	) {
 		return AddShader(vertex, std::vector<std::filesystem::path>{ fragment }, hash);
 	}
 
+	// Returns nullptr if the sources could not be preprocessed
 	Shader *AddShader(
-		std::filesystem::path &vertex,
-		std::vector<std::filesystem::path> &fragments,
+		const std::filesystem::path &vertex,
+		const std::vector<std::filesystem::path> &fragments,
 		std::uint32_t hash
 	) {
 		Shader shader;
 
-		shader.vertex.Compile(vertex);
-
-		for (const auto &fragment : fragments) {
-			FragmentShader fragmentShader;
-			fragmentShader.Compile(fragment);
-			shader.fragments.emplace_back(std::move(fragmentShader));
-		}
-
-		shader.program.Attach(
-			shader.vertex,
-			shader.fragments
-		);
+		if (!Build(shader, vertex, fragments, {}))
+			return nullptr;
 
 		auto program = &shaders.emplace(std::make_pair(hash, std::move(shader))).first->second;
 
@@ -56,6 +51,56 @@ public:
 		return program;
 	}
 
+	// Registers a shader whose permutations are compiled lazily
+	// (and only once) for each set of defines passed to UseVariant().
+	// Returns false, keeping the existing registration (and whatever
+	// has been compiled for it, which may be in use), if the hash is
+	// already taken.
+	bool AddShaderVariants(
+		const std::filesystem::path &vertex,
+		const std::vector<std::filesystem::path> &fragments,
+		std::uint32_t hash
+	) {
+		return variants.try_emplace(hash, Variants{ vertex, fragments, {} }).second;
+	}
+
+	// Returns nullptr if the sources could not be preprocessed
+	Shader *GetVariant(std::uint32_t hash, const ShaderDefines &defines) {
+		auto &variant = variants.at(hash);
+		auto key = ShaderPreprocessor::GetKey(defines);
+
+		if (auto iter = variant.shaders.find(key); iter != variant.shaders.end())
+			return &iter->second;
+
+		Shader shader;
+
+		if (!Build(shader, variant.vertex, variant.fragments, defines))
+			return nullptr;
+
+		return &variant.shaders.emplace(std::make_pair(std::move(key), std::move(shader))).first->second;
+	}
+
+	// Keeps the current shader if the variant can't be built
+	bool UseVariant(std::uint32_t hash, const ShaderDefines &defines) {
+		auto shader = GetVariant(hash, defines);
+		if (!shader)
+			return false;
+
+		currentShader = shader;
+		currentShader->program.Use();
+
+		return true;
+	}
+
+	// Linked programs will be cached in (and loaded from) the
+	// provided directory from now on, if the driver allows it
+	void SetProgramBinaryCache(const std::filesystem::path &directory) {
+		if (ProgramBinaryCache::IsSupported())
+			binaryCache = std::make_unique<ProgramBinaryCache>(directory);
+		else
+			binaryCache.reset();
+	}
+
 	const Shader *GetShader(std::uint32_t hash) const {
 		return &shaders.at(hash);
 	}
@@ -125,16 +170,85 @@ public:
 		Apply();
 	}
 
+	// The quad framebuffers are drawn with. VAOs aren't shared between
+	// GL contexts, so each Context has its own.
+	QuadMesh &GetQuadMesh() {
+		if (!quadMesh)
+			quadMesh = std::make_unique<QuadMesh>();
+
+		return *quadMesh;
+	}
+
 	const float &GetYOffset() const { return yOffset; }
 	void SetYOffset(float yOffset) { this->yOffset = yOffset; }
 
 private:
+	// Only fails when preprocessing does (which logs why), compile
+	// and link errors are left to the program as before
+	bool Build(
+		Shader &shader,
+		const std::filesystem::path &vertex,
+		const std::vector<std::filesystem::path> &fragments,
+		const ShaderDefines &defines
+	) {
+		auto vertexSource = preprocessor.Process(vertex, defines);
+		if (!vertexSource)
+			return false;
+
+		std::vector<std::string> fragmentSources;
+		for (const auto &fragment : fragments) {
+			auto fragmentSource = preprocessor.Process(fragment, defines);
+			if (!fragmentSource)
+				return false;
+
+			fragmentSources.emplace_back(std::move(*fragmentSource));
+		}
+
+		std::uint64_t key = 0;
+
+		if (binaryCache) {
+			key = binaryCache->GetKey(*vertexSource, fragmentSources);
+
+			// Nothing to compile on a hit
+			if (binaryCache->Load(shader.program, key))
+				return true;
+		}
+
+		shader.vertex.CompileSource(*vertexSource);
+
+		for (const auto &fragmentSource : fragmentSources) {
+			FragmentShader fragmentShader;
+			fragmentShader.CompileSource(fragmentSource);
+			shader.fragments.emplace_back(std::move(fragmentShader));
+		}
+
+		if (shader.program.Attach(shader.vertex, shader.fragments) && binaryCache)
+			binaryCache->Store(shader.program, key);
+
+		return true;
+	}
+
+	struct Variants {
+		std::filesystem::path vertex;
+		std::vector<std::filesystem::path> fragments;
+
+		// Keyed by ShaderPreprocessor::GetKey()
+		std::map<std::string, Shader> shaders;
+	};
+
 	std::map<std::uint32_t, Shader> shaders;
+	std::map<std::uint32_t, Variants> variants;
 	Shader *currentShader = nullptr;
 
+	ShaderPreprocessor preprocessor;
+
 	glm::mat4 identity;
 	glm::mat4 projection;
 
 	float yOffset = 0.0f;
+
+	std::unique_ptr<ProgramBinaryCache> binaryCache;
+
+	std::unique_ptr<QuadMesh> quadMesh;
 };
 }
\ No newline at end of file
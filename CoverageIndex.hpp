@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+namespace Fetcko {
+// Maps code points to the first face (in fallback order) that has a
+// glyph for them. Every cmap is walked once up front and merged into
+// sorted, non-overlapping ranges, so finding the face for a code
+// point is a binary search instead of a FT_Get_Char_Index per face.
+class CoverageIndex {
+public:
+	struct Range {
+		FT_ULong first = 0;
+		FT_ULong last = 0;	// Inclusive
+		std::size_t face = 0;
+	};
+
+	void Build(const std::vector<FT_Face> &faces) {
+		std::vector<std::pair<FT_ULong, std::size_t>> codePoints;
+
+		for (std::size_t i = 0; i < faces.size(); ++i) {
+			FT_UInt index = 0;
+			for (auto c = FT_Get_First_Char(faces[i], &index); index != 0; c = FT_Get_Next_Char(faces[i], c, &index))
+				codePoints.emplace_back(c, i);
+		}
+
+		// Stable, so that earlier faces come first for the same code point
+		std::stable_sort(codePoints.begin(), codePoints.end(), [](const auto &left, const auto &right) {
+			return left.first < right.first;
+		});
+
+		ranges.clear();
+
+		for (const auto &[c, face] : codePoints) {
+			if (!ranges.empty()) {
+				auto &last = ranges.back();
+
+				// Already covered by an earlier face
+				if (c <= last.last)
+					continue;
+
+				if (c == last.last + 1 && face == last.face) {
+					last.last = c;
+					continue;
+				}
+			}
+
+			ranges.emplace_back(Range{ c, c, face });
+		}
+
+		ranges.shrink_to_fit();
+	}
+
+	std::optional<std::size_t> Find(FT_ULong c) const {
+		auto iter = std::upper_bound(ranges.begin(), ranges.end(), c, [](FT_ULong c, const Range &range) {
+			return c < range.first;
+		});
+
+		if (iter == ranges.begin() || (--iter)->last < c)
+			return std::nullopt;
+
+		return iter->face;
+	}
+
+	void Clear() { ranges.clear(); }
+
+	const std::vector<Range> &GetRanges() const { return ranges; }
+
+private:
+	std::vector<Range> ranges;
+};
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Fetcko {
+// 64-bit FNV-1a, for hashes that have to be
+// stable between runs (unlike std::hash)
+class Fnv1a {
+public:
+	static constexpr uint64_t Basis = 0xcbf29ce484222325ull;
+	static constexpr uint64_t Prime = 0x100000001b3ull;
+
+	static uint64_t Hash(const void *data, std::size_t size, uint64_t hash = Basis) {
+		auto bytes = static_cast<const uint8_t *>(data);
+
+		for (std::size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= Prime;
+		}
+
+		return hash;
+	}
+
+	static constexpr uint64_t Hash(const std::string_view &string, uint64_t hash = Basis) {
+		for (const auto &c : string) {
+			hash ^= static_cast<uint8_t>(c);
+			hash *= Prime;
+		}
+
+		return hash;
+	}
+};
+}
@@ -0,0 +1,287 @@
+#include "FrameCapture.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include <lodepng.h>
+
+#include "PixelConversion.hpp"
+
+namespace Fetcko {
+namespace {
+void WriteBigEndian(std::vector<uint8_t> &output, uint32_t value) {
+	output.push_back(static_cast<uint8_t>(value >> 24));
+	output.push_back(static_cast<uint8_t>(value >> 16));
+	output.push_back(static_cast<uint8_t>(value >> 8));
+	output.push_back(static_cast<uint8_t>(value));
+}
+
+// Rows are written last to first, to come out top-down
+std::vector<uint8_t> EncodeQoi(const uint8_t *rgba, uint32_t width, uint32_t height) {
+	struct Pixel {
+		uint8_t r = 0, g = 0, b = 0, a = 0;
+
+		bool operator==(const Pixel &right) const { return r == right.r && g == right.g && b == right.b && a == right.a; }
+		bool operator!=(const Pixel &right) const { return !(*this == right); }
+	};
+
+	std::vector<uint8_t> ret;
+	ret.reserve(14 + static_cast<std::size_t>(width) * height * 2 + 8);
+
+	ret.insert(ret.end(), { 'q', 'o', 'i', 'f' });
+	WriteBigEndian(ret, width);
+	WriteBigEndian(ret, height);
+	ret.push_back(4);	// RGBA
+	ret.push_back(0);	// sRGB with linear alpha
+
+	Pixel index[64];
+	Pixel previous{ 0, 0, 0, 255 };
+	int run = 0;
+
+	const auto count = static_cast<std::size_t>(width) * height;
+	std::size_t written = 0;
+
+	for (auto y = height; y-- > 0; ) {
+		auto source = rgba + static_cast<std::size_t>(y) * width * 4;
+
+		for (uint32_t x = 0; x < width; ++x, source += 4) {
+			const Pixel pixel{ source[0], source[1], source[2], source[3] };
+			const auto last = ++written == count;
+
+			if (pixel == previous) {
+				if (++run == 62 || last) {
+					ret.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+					run = 0;
+				}
+
+				continue;
+			}
+
+			if (run > 0) {
+				ret.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+				run = 0;
+			}
+
+			const auto hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+
+			if (index[hash] == pixel) {
+				ret.push_back(static_cast<uint8_t>(hash));
+			} else {
+				index[hash] = pixel;
+
+				if (pixel.a == previous.a) {
+					const auto red = static_cast<int8_t>(pixel.r - previous.r);
+					const auto green = static_cast<int8_t>(pixel.g - previous.g);
+					const auto blue = static_cast<int8_t>(pixel.b - previous.b);
+
+					const auto redGreen = red - green;
+					const auto blueGreen = blue - green;
+
+					if (red >= -2 && red <= 1 && green >= -2 && green <= 1 && blue >= -2 && blue <= 1) {
+						ret.push_back(static_cast<uint8_t>(0x40 | (red + 2) << 4 | (green + 2) << 2 | (blue + 2)));
+					} else if (green >= -32 && green <= 31 && redGreen >= -8 && redGreen <= 7 && blueGreen >= -8 && blueGreen <= 7) {
+						ret.push_back(static_cast<uint8_t>(0x80 | (green + 32)));
+						ret.push_back(static_cast<uint8_t>((redGreen + 8) << 4 | (blueGreen + 8)));
+					} else {
+						ret.insert(ret.end(), { 0xFE, pixel.r, pixel.g, pixel.b });
+					}
+				} else {
+					ret.insert(ret.end(), { 0xFF, pixel.r, pixel.g, pixel.b, pixel.a });
+				}
+			}
+
+			previous = pixel;
+		}
+	}
+
+	ret.insert(ret.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+
+	return ret;
+}
+}
+
+FrameCapture::FrameCapture(
+	const std::filesystem::path &directory,
+	Format format,
+	Policy policy,
+	std::size_t capacity,
+	std::size_t workers
+) :
+	directory(directory),
+	format(format),
+	policy(policy),
+	capacity(std::max<std::size_t>(capacity, 1)),
+	pool(std::min(std::max<std::size_t>(workers, 1), this->capacity)) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	if (error)
+		logger.LogError("Could not create capture directory ", directory.u8string(), ": ", error.message());
+}
+
+FrameCapture::~FrameCapture() {
+	Flush();
+}
+
+bool FrameCapture::Submit(std::vector<uint8_t> &&pixels, GLsizei width, GLsizei height) {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		++statistics.submitted;
+
+		if (pending >= capacity) {
+			switch (policy) {
+			case Policy::Block:
+				condition.wait(lock, [this] { return pending < capacity; });
+				break;
+			case Policy::DropOldest:
+				// Everything might already be encoding
+				if (!queue.empty()) {
+					queue.pop_front();
+					--pending;
+					++statistics.dropped;
+					break;
+				}
+				[[fallthrough]];
+			case Policy::DropNewest:
+				++statistics.dropped;
+				return false;
+			}
+		}
+
+		queue.emplace_back(Frame{ nextIndex++, std::move(pixels), width, height });
+		++pending;
+	}
+
+	// One task per frame; a task whose frame got dropped finds nothing to do
+	pool.Submit([this] { EncodeNext(); });
+
+	return true;
+}
+
+void FrameCapture::Flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] { return pending == 0; });
+}
+
+FrameCapture::Statistics FrameCapture::GetStatistics() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return statistics;
+}
+
+void FrameCapture::EncodeNext() {
+	Frame frame;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (queue.empty())
+			return;
+
+		frame = std::move(queue.front());
+		queue.pop_front();
+	}
+
+	const auto encoded = Encode(frame);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		--pending;
+		++(encoded ? statistics.encoded : statistics.failed);
+	}
+
+	condition.notify_all();
+}
+
+bool FrameCapture::Encode(Frame &frame) const {
+	static constexpr const char *Extensions[] = { "bmp", "qoi", "png" };
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "frame_%06zu.%s", frame.index, Extensions[static_cast<int>(format)]);
+	const auto path = directory / name;
+
+	const auto width = static_cast<std::size_t>(frame.width);
+	const auto height = static_cast<std::size_t>(frame.height);
+
+	if (format == Format::Bmp) {
+		std::ofstream outFile(path, std::ios::binary | std::ios::out);
+
+		const auto pitch = PixelConversion::GetPitch(width);
+
+		BMPHeader header;
+		header.offset = sizeof(BMPHeader) + sizeof(BITMAPINFOHEADER);
+		header.size = static_cast<uint32_t>(pitch * height + header.offset);
+
+		BITMAPINFOHEADER infoHeader;
+		infoHeader.width = frame.width;
+		infoHeader.height = frame.height;
+
+		outFile.write(reinterpret_cast<const char *>(&header), sizeof(BMPHeader));
+		outFile.write(reinterpret_cast<const char *>(&infoHeader), sizeof(BITMAPINFOHEADER));
+
+		// BMPs are stored bottom-up, just like the readback
+		std::vector<uint8_t> row(pitch, 0);
+		for (std::size_t y = 0; y < height; ++y) {
+			PixelConversion::ConvertRow(frame.pixels.data() + y * width * 4, width, PixelConversion::Order::Bgr, row.data());
+			outFile.write(reinterpret_cast<const char *>(row.data()), pitch);
+		}
+
+		outFile.close();
+
+		if (!outFile) {
+			logger.LogError("Could not write ", path.u8string());
+			return false;
+		}
+
+		return true;
+	}
+
+	if (format == Format::Qoi) {
+		auto qoi = EncodeQoi(frame.pixels.data(), frame.width, frame.height);
+
+		std::ofstream outFile(path, std::ios::binary | std::ios::out);
+		outFile.write(reinterpret_cast<const char *>(qoi.data()), qoi.size());
+		outFile.close();
+
+		if (!outFile) {
+			logger.LogError("Could not write ", path.u8string());
+			return false;
+		}
+
+		return true;
+	}
+
+	// PNGs are top-down, and we own the pixels anyway
+	const auto stride = width * 4;
+	for (std::size_t y = 0; y < height / 2; ++y) {
+		std::swap_ranges(
+			frame.pixels.begin() + y * stride,
+			frame.pixels.begin() + (y + 1) * stride,
+			frame.pixels.begin() + (height - 1 - y) * stride
+		);
+	}
+
+	// Trade size for speed: no filtering and a short, greedy LZ77 search
+	lodepng::State state;
+	state.encoder.auto_convert = 0;
+	state.encoder.filter_strategy = LFS_ZERO;
+	state.encoder.zlibsettings.windowsize = 1024;
+	state.encoder.zlibsettings.nicematch = 32;
+	state.encoder.zlibsettings.lazymatching = 0;
+
+	std::vector<unsigned char> png;
+	if (auto error = lodepng::encode(png, frame.pixels.data(), frame.width, frame.height, state)) {
+		logger.LogError("Could not encode ", path.u8string(), ": ", lodepng_error_text(error));
+		return false;
+	}
+
+	if (auto error = lodepng::save_file(png, path.u8string())) {
+		logger.LogError("Could not write ", path.u8string(), ": ", lodepng_error_text(error));
+		return false;
+	}
+
+	return true;
+}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include "Framebuffer.hpp"
+#include "Logger.hpp"
+#include "ThreadPool.hpp"
+
+namespace Fetcko {
+// Records frames to numbered image files without encoding on the GL
+// thread: frames go into a bounded queue that a pool of workers
+// drains. What happens when the encoders fall behind is up to the
+// policy; Block trades hitches for completeness, the others drop.
+class FrameCapture : public LoggableClass {
+public:
+	enum class Format {
+		Bmp,	// Uncompressed, cheapest to write
+		Qoi,	// See https://qoiformat.org, several times faster than PNG
+		Png		// Fastest lodepng settings, still the slowest of the three
+	};
+
+	enum class Policy {
+		Block,		// Submit() waits for room in the queue
+		DropNewest,	// Frames submitted while the queue is full are skipped
+		DropOldest	// The oldest frame not being encoded yet makes room
+	};
+
+	struct Statistics {
+		std::size_t submitted = 0;
+		std::size_t encoded = 0;
+		std::size_t dropped = 0;
+		std::size_t failed = 0;
+	};
+
+	FrameCapture(
+		const std::filesystem::path &directory,
+		Format format = Format::Qoi,
+		Policy policy = Policy::Block,
+		std::size_t capacity = 8,
+		std::size_t workers = std::thread::hardware_concurrency()
+	);
+
+	// Waits for everything queued to be written
+	~FrameCapture();
+
+	// Takes RGBA pixels as read back from a framebuffer (bottom row
+	// first). Returns false if the frame got dropped by the policy.
+	bool Submit(std::vector<uint8_t> &&pixels, GLsizei width, GLsizei height);
+
+	// Starts an asynchronous readback of the framebuffer and submits
+	// the earlier ones that have landed since, so that capturing a
+	// frame normally doesn't wait on the GPU. Capture a single
+	// framebuffer per FrameCapture, then call FinishCapture().
+	template<bool Multisampled>
+	void Capture(Framebuffer<Multisampled> &framebuffer) {
+		SubmitReadbacks(framebuffer, MaxReadbacks - 1);
+		tickets.emplace_back(framebuffer.ReadbackAsync());
+	}
+
+	// Submits all outstanding readbacks, waiting for them if needed
+	template<bool Multisampled>
+	void FinishCapture(Framebuffer<Multisampled> &framebuffer) {
+		SubmitReadbacks(framebuffer, 0);
+	}
+
+	// Blocks until every submitted frame has been written (or dropped)
+	void Flush();
+
+	Statistics GetStatistics();
+
+private:
+	// Framebuffers keep three readbacks in flight by default
+	static constexpr std::size_t MaxReadbacks = 3;
+
+	struct Frame {
+		std::size_t index;
+		std::vector<uint8_t> pixels;
+		GLsizei width;
+		GLsizei height;
+	};
+
+	// Submits finished readbacks in order, waiting on the
+	// oldest ones until at most pending are left
+	template<bool Multisampled>
+	void SubmitReadbacks(Framebuffer<Multisampled> &framebuffer, std::size_t pending) {
+		while (!tickets.empty()) {
+			std::vector<uint8_t> pixels;
+
+			const auto ready = tickets.size() > pending ?
+				framebuffer.WaitReadback(tickets.front(), pixels) :
+				framebuffer.PollReadback(tickets.front(), pixels);
+
+			if (!ready && tickets.size() <= pending)
+				break;
+
+			if (ready)
+				Submit(std::move(pixels), framebuffer.GetWidth(), framebuffer.GetHeight());
+
+			tickets.pop_front();
+		}
+	}
+
+	void EncodeNext();
+	bool Encode(Frame &frame) const;
+
+	std::filesystem::path directory;
+	Format format;
+	Policy policy;
+	std::size_t capacity;
+
+	// Queued plus currently encoding
+	std::size_t pending = 0;
+	std::size_t nextIndex = 0;
+
+	std::deque<Frame> queue;
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	Statistics statistics;
+
+	std::deque<uint64_t> tickets;
+
+	// Last, so that its workers are gone before anything they use
+	ThreadPool pool;
+};
+}
@@ -6,8 +6,8 @@
 
 #include "Buffer.hpp"
 #include "Context.hpp"
+#include "PixelConversion.hpp"
 #include "Texture.hpp"
-#include "VertexArray.hpp"
 
 #define VALIDATE 0
 
@@ -40,9 +40,37 @@ struct [[gnu::packed]] BITMAPINFOHEADER {
 template<bool Multisampled>
 class Framebuffer : public LoggableClass {
 public:
-	Framebuffer(GLsizei width, GLsizei height, GLint format = GL_RGBA) : texture(format) {
+	struct Options {
+		// Clamped to GL_MAX_SAMPLES, and only used when multisampled
+		GLsizei samples = 4;
+
+		// Internal format of the depth and/or stencil buffer (e.g.
+		// GL_DEPTH24_STENCIL8), or GL_NONE for 2D content that
+		// doesn't need one. Only multisampled framebuffers get one
+		// by default.
+		GLenum depthStencilFormat = Multisampled ? GL_DEPTH_COMPONENT : GL_NONE;
+
+		// Which buffers of the multisampled framebuffer (GL_COLOR_BUFFER_BIT
+		// and so on) can be thrown away after each Blit(), which saves tilers
+		// from writing them back to memory. Add the color buffer when it gets
+		// cleared before every use.
+		GLbitfield invalidateAfterBlit = GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
+	};
+
+	Framebuffer(GLsizei width, GLsizei height, GLint format = GL_RGBA) :
+		Framebuffer(width, height, format, Options()) {
+
+	}
+
+	Framebuffer(GLsizei width, GLsizei height, GLint format, const Options &options) :
+		texture(format),
+		samples(Multisampled ? options.samples : 0),
+		depthStencilFormat(options.depthStencilFormat),
+		invalidateAfterBlit(options.invalidateAfterBlit) {
 		this->width = width;
 		this->height = height;
+		contentWidth = width;
+		contentHeight = height;
 
 		glGenFramebuffers(1, &handle);
 
@@ -56,54 +84,48 @@ public:
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.GetHandle(), 0);
 		texture.Unbind();
 
-#if VALIDATE
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-			logger.LogError("Framebuffer not complete!");
-#endif
-
 		if constexpr (Multisampled) {
+			GLint maxSamples = 0;
+			glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+
+			if (samples > maxSamples) {
+				logger.LogWarning(samples, " samples requested, but only ", maxSamples, " are supported");
+				samples = maxSamples;
+			}
+
+			samples = std::max(samples, 1);
+
 			glGenFramebuffers(1, &multisampledHandle);
 
 			Bind();
 
 			multisampledTexture = std::make_unique<MultisampledTexture2D>(format);
 			multisampledTexture->Bind();
-			multisampledTexture->TexImage2DMultisample(width, height);
+			multisampledTexture->TexImage2DMultisample(width, height, samples);
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, multisampledTexture->GetHandle(), 0);
 			multisampledTexture->Unbind();
+		}
 
-			// Generate the depth attachment
+		// Goes on whichever framebuffer is rendered into
+		if (depthStencilFormat != GL_NONE) {
 			glGenRenderbuffers(1, &depthBuffer);
 			glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
-			glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT, width, height);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+			if constexpr (Multisampled)
+				glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, depthStencilFormat, width, height);
+			else
+				glRenderbufferStorage(GL_RENDERBUFFER, depthStencilFormat, width, height);
+
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GetDepthStencilAttachment(), GL_RENDERBUFFER, depthBuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		}
 
 #if VALIDATE
-			if (auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER); status != GL_FRAMEBUFFER_COMPLETE)
-				logger.LogError("Multisampled framebuffer not complete! status = ", status);
+		if (auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER); status != GL_FRAMEBUFFER_COMPLETE)
+			logger.LogError("Framebuffer not complete! status = ", status);
 #endif
-		}
 
 		Unbind();
-
-		std::vector<float> squareBuffer = {
-			0                          , 0                           , Buffers::TexCoordBuffer[0], Buffers::TexCoordBuffer[1],
-			0                          , static_cast<GLfloat>(height), Buffers::TexCoordBuffer[2], Buffers::TexCoordBuffer[3],
-			static_cast<GLfloat>(width), static_cast<GLfloat>(height), Buffers::TexCoordBuffer[4], Buffers::TexCoordBuffer[5],
-			static_cast<GLfloat>(width), 0                           , Buffers::TexCoordBuffer[6], Buffers::TexCoordBuffer[7]
-		};
-
-		vao.Bind();
-		vbo.Bind();
-		vao.AddAttribute(VertexArray::Attribute(0, 2, 4 * sizeof(float)));
-		vao.AddAttribute(VertexArray::Attribute(1, 2, 4 * sizeof(float), 2 * sizeof(float)));
-		vbo.BufferData(squareBuffer);
-		vbo.Unbind();
-		vao.Unbind();
-
-		eab.Bind();
-		eab.BufferData<std::size(Buffers::SquareBuffer)>(Buffers::SquareBuffer);
-		eab.Unbind();
 	}
 
 	Framebuffer(Framebuffer &&other) noexcept {
@@ -112,11 +134,10 @@ public:
 
 		width = other.width;
 		height = other.height;
+		contentWidth = other.contentWidth;
+		contentHeight = other.contentHeight;
 
 		texture = std::move(other.texture);
-		vao = std::move(other.vao);
-		vbo = std::move(other.vbo);
-		eab = std::move(other.eab);
 
 		multisampledHandle = other.multisampledHandle;
 		other.multisampledHandle = 0;
@@ -124,15 +145,26 @@ public:
 		multisampledTexture = std::move(other.multisampledTexture);
 		depthBuffer = other.depthBuffer;
 		other.depthBuffer = 0;
+
+		samples = other.samples;
+		depthStencilFormat = other.depthStencilFormat;
+		invalidateAfterBlit = other.invalidateAfterBlit;
+
+		readbacks = std::move(other.readbacks);
+		nextTicket = other.nextTicket;
 	}
 
 	virtual ~Framebuffer() {
+		for (auto &readback : readbacks) {
+			if (readback.fence)
+				glDeleteSync(readback.fence);
+		}
+
 		glDeleteFramebuffers(1, &handle);
+		glDeleteRenderbuffers(1, &depthBuffer);
 
-		if constexpr (Multisampled) {
+		if constexpr (Multisampled)
 			glDeleteFramebuffers(1, &multisampledHandle);
-			glDeleteRenderbuffers(1, &depthBuffer);
-		}
 	}
 
 	void Bind() {
@@ -163,11 +195,14 @@ public:
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target ? target->multisampledHandle : handle);
 
 		glBlitFramebuffer(
-			0, height, width, 0, // invert Y so we aren't upside-down
-			0, 0, width, height,
+			0, contentHeight, contentWidth, 0, // invert Y so we aren't upside-down
+			0, 0, contentWidth, contentHeight,
 			GL_COLOR_BUFFER_BIT,
 			GL_LINEAR
 		);
+
+		Invalidate(GL_READ_FRAMEBUFFER, invalidateAfterBlit);
+
 		Unbind();
 	}
 
@@ -194,12 +229,16 @@ public:
 		texture.Unbind();
 	}
 
+	// BMP wants BGR, with rows padded to 4 bytes; each row gets
+	// converted on its own and written out straight away
 	void Save(const std::filesystem::path &path) {
-		auto rgb = GetBitmap(GL_RGB);
+		const auto rgba = ReadPixels();
+		const auto pitch = PixelConversion::GetPitch(width);
+
 		std::ofstream outFile(path, std::ios::binary | std::ios::out);
 		BMPHeader header;
 		header.offset = sizeof(BMPHeader) + sizeof(BITMAPINFOHEADER);
-		header.size = width * height * 3 + header.offset;
+		header.size = static_cast<uint32_t>(pitch * height + header.offset);
 
 		BITMAPINFOHEADER infoHeader;
 		infoHeader.width = width;
@@ -207,7 +246,14 @@ public:
 		
 		outFile.write(reinterpret_cast<const char *>(&header), sizeof(BMPHeader));
 		outFile.write(reinterpret_cast<const char *>(&infoHeader), sizeof(BITMAPINFOHEADER));
-		outFile.write(reinterpret_cast<const char *>(rgb.data()), static_cast<GLsizei>(std::ceil(width * 3 / 4.0f) * 4) * height);
+
+		// Padding stays zeroed, since only the pixels get overwritten
+		std::vector<uint8_t> row(pitch, 0);
+		for (GLsizei y = height - 1; y >= 0; --y) {
+			PixelConversion::ConvertRow(rgba.data() + static_cast<std::size_t>(y) * width * 4, width, PixelConversion::Order::Bgr, row.data());
+			outFile.write(reinterpret_cast<const char *>(row.data()), pitch);
+		}
+
 		outFile.close();
 	}
 
@@ -219,57 +265,228 @@ public:
 	const GLsizei &GetWidth() const { return width; }
 	const GLsizei &GetHeight() const { return height; }
 
-	std::vector<uint8_t> GetBitmap(GLenum format = GL_RGBA, bool upsideDown = true) const {
-		texture.Bind();
+	// Restricts drawing and blitting to the bottom left width x height
+	// of the target, for when it's bigger than what was rendered into
+	// it. Readbacks and saving still cover the whole target.
+	void SetContentSize(GLsizei width, GLsizei height) {
+		contentWidth = std::min(width, this->width);
+		contentHeight = std::min(height, this->height);
+	}
 
-		auto pitch = static_cast<GLsizei>(std::ceil(width * 3 / 4.0f) * 4);
+	const GLsizei &GetContentWidth() const { return contentWidth; }
+	const GLsizei &GetContentHeight() const { return contentHeight; }
 
-		std::vector<uint8_t> rgba(width * height * 4);
-		std::vector<uint8_t> rgb;
+	// 0 unless multisampled
+	const GLsizei &GetSamples() const { return samples; }
+	const GLenum &GetDepthStencilFormat() const { return depthStencilFormat; }
 
-		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+	const Texture2D &GetTexture() const { return texture; }
 
-		if (format == GL_RGB) {
-			rgb.resize(pitch * height);
-			memset(rgb.data(), 0, pitch * height);
-			for (GLsizei y = 0; y < height; ++y) {
-				for (GLsizei x = 0; x < width; ++x) {
-					memcpy(rgb.data() + (y * pitch) + (x * 3), rgba.data() + (y * width + x) * 4, 3);
+	// GL_RGBA, or 24-bit GL_RGB / GL_BGR with rows padded to 4 bytes
+	std::vector<uint8_t> GetBitmap(GLenum format = GL_RGBA, bool upsideDown = true) const {
+		auto rgba = ReadPixels();
+
+		if (format == GL_RGBA) {
+			// We need to flip vertically, since the texture is loaded upside-down
+			if (upsideDown) {
+				const auto stride = static_cast<std::size_t>(width) * 4;
+
+				for (GLsizei y = 0; y < height / 2; ++y) {
+					std::swap_ranges(
+						rgba.begin() + y * stride,
+						rgba.begin() + (y + 1) * stride,
+						rgba.begin() + (height - 1 - y) * stride
+					);
 				}
 			}
+
+			return rgba;
 		}
 
-		// We need to flip vertically, since the texture is loaded upside-down
-		if (upsideDown) {
-			std::vector<uint8_t> flipped(height * (format == GL_RGBA ? width * 4 : pitch));
+		const auto pitch = PixelConversion::GetPitch(width);
+
+		std::vector<uint8_t> ret(pitch * height);
+		PixelConversion::Convert(
+			rgba.data(),
+			width,
+			height,
+			format == GL_BGR ? PixelConversion::Order::Bgr : PixelConversion::Order::Rgb,
+			upsideDown,
+			ret.data(),
+			pitch
+		);
 
-			for (GLsizei y = height - 1; ; --y) {
-				memcpy(
-					flipped.data() + (height - 1 - y) * (format == GL_RGBA ? width * 4 : pitch),
-					&(format == GL_RGBA ? rgba : rgb).data()[y * (format == GL_RGBA ? width * 4 : pitch)],
-					(format == GL_RGBA ? width * 4 : pitch)
-				);
+		return ret;
+	}
 
-				if (y == 0)
-					break;
-			}
+	using ReadbackTicket = uint64_t;
+
+	// Queues a copy of the (resolved) color attachment into a pixel pack
+	// buffer and returns right away. The pixels can be claimed through
+	// PollReadback() or WaitReadback() once the GPU gets to it.
+	//
+	// Buffers are reused round-robin, so a ticket that hasn't been
+	// claimed by the time its buffer comes up again is dropped.
+	ReadbackTicket ReadbackAsync() {
+		if (readbacks.empty())
+			readbacks.resize(readbackRingSize);
+
+		const auto ticket = nextTicket++;
+		auto &readback = readbacks[ticket % readbacks.size()];
+
+		if (readback.fence) {
+			logger.LogWarning("Dropping unclaimed readback ", readback.ticket);
+			glDeleteSync(readback.fence);
+		}
+
+		readback.ticket = ticket;
+
+		readback.buffer.Bind();
+		readback.buffer.BufferData(static_cast<std::size_t>(width) * height * 4, GL_STREAM_READ);
 
-			return flipped;
+		// Whoever is reading from another framebuffer keeps doing so
+		GLint previousReadFramebuffer = 0;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, handle);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+
+		readback.buffer.Unbind();
+
+		readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		return ticket;
+	}
+
+	// Copies the pixels (RGBA, bottom row first) into the provided vector if
+	// the readback has finished. Returns false if it hasn't yet, or if the
+	// ticket was already claimed or dropped.
+	bool PollReadback(ReadbackTicket ticket, std::vector<uint8_t> &pixels) {
+		return ClaimReadback(ticket, pixels, 0);
+	}
+
+	// Same as PollReadback(), but blocks for up to timeout nanoseconds
+	bool WaitReadback(ReadbackTicket ticket, std::vector<uint8_t> &pixels, GLuint64 timeout = GL_TIMEOUT_IGNORED) {
+		return ClaimReadback(ticket, pixels, timeout);
+	}
+
+	// How many readbacks can be in flight at once
+	void SetReadbackRingSize(std::size_t size) {
+		for (auto &readback : readbacks) {
+			if (readback.fence)
+				glDeleteSync(readback.fence);
 		}
 
-		return format == GL_RGBA ? rgba : rgb;
+		readbacks.clear();
+		readbackRingSize = std::max<std::size_t>(size, 1);
 	}
 
 protected:
+	std::vector<uint8_t> ReadPixels() const {
+		std::vector<uint8_t> ret(static_cast<std::size_t>(width) * height * 4);
+
+		texture.Bind();
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, ret.data());
+
+		return ret;
+	}
+
+	bool ClaimReadback(ReadbackTicket ticket, std::vector<uint8_t> &pixels, GLuint64 timeout) {
+		if (readbacks.empty())
+			return false;
+
+		auto &readback = readbacks[ticket % readbacks.size()];
+		if (!readback.fence || readback.ticket != ticket)
+			return false;
+
+		switch (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout)) {
+		case GL_ALREADY_SIGNALED:
+		case GL_CONDITION_SATISFIED:
+			break;
+		case GL_TIMEOUT_EXPIRED:
+			return false;
+		default:
+			logger.LogError("Waiting on readback ", ticket, " failed");
+			return false;
+		}
+
+		glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+
+		const auto size = static_cast<std::size_t>(width) * height * 4;
+		pixels.resize(size);
+
+		readback.buffer.Bind();
+
+		auto ret = false;
+		if (auto data = readback.buffer.MapBufferRange(0, size)) {
+			std::copy_n(data, size, pixels.begin());
+			ret = readback.buffer.UnmapBuffer();
+		}
+
+		readback.buffer.Unbind();
+
+		if (!ret)
+			logger.LogError("Could not map readback ", ticket);
+
+		return ret;
+	}
+
+	GLenum GetDepthStencilAttachment() const {
+		switch (depthStencilFormat) {
+		case GL_DEPTH_STENCIL:
+		case GL_DEPTH24_STENCIL8:
+		case GL_DEPTH32F_STENCIL8:
+			return GL_DEPTH_STENCIL_ATTACHMENT;
+		case GL_STENCIL_INDEX:
+		case GL_STENCIL_INDEX1:
+		case GL_STENCIL_INDEX4:
+		case GL_STENCIL_INDEX8:
+		case GL_STENCIL_INDEX16:
+			return GL_STENCIL_ATTACHMENT;
+		default:
+			return GL_DEPTH_ATTACHMENT;
+		}
+	}
+
+	// Tells the driver the contents of the given buffers of the framebuffer
+	// bound to target won't be needed again. Does nothing without
+	// GL_ARB_invalidate_subdata (core since 4.3).
+	void Invalidate(GLenum target, GLbitfield buffers) const {
+		if (!GLAD_GL_ARB_invalidate_subdata || buffers == 0)
+			return;
+
+		GLenum attachments[3];
+		GLsizei count = 0;
+
+		if (buffers & GL_COLOR_BUFFER_BIT)
+			attachments[count++] = GL_COLOR_ATTACHMENT0;
+
+		if (depthStencilFormat != GL_NONE) {
+			const auto attachment = GetDepthStencilAttachment();
+
+			if ((buffers & GL_DEPTH_BUFFER_BIT) && attachment != GL_STENCIL_ATTACHMENT)
+				attachments[count++] = GL_DEPTH_ATTACHMENT;
+			if ((buffers & GL_STENCIL_BUFFER_BIT) && attachment != GL_DEPTH_ATTACHMENT)
+				attachments[count++] = GL_STENCIL_ATTACHMENT;
+		}
+
+		if (count > 0)
+			glInvalidateFramebuffer(target, count, attachments);
+	}
+
 	inline void _Draw(GLfloat x, GLfloat y, Context &context) {
 		context.Translate(x, y, 0);
-		context.Apply();
 
-		vao.Bind();
-		eab.Bind();
-		eab.DrawElements(GL_TRIANGLES);
-		eab.Unbind();
-		vao.Unbind();
+		context.GetQuadMesh().Draw(
+			context.GetShaderProgram(),
+			context.GetProjection(),
+			static_cast<GLfloat>(contentWidth),
+			static_cast<GLfloat>(contentHeight),
+			static_cast<GLfloat>(contentWidth) / width,
+			static_cast<GLfloat>(contentHeight) / height
+		);
 	}
 
 	GLuint handle = 0;
@@ -277,15 +494,29 @@ protected:
 	GLsizei width = 0;
 	GLsizei height = 0;
 
-	Texture2D texture;
+	// Only the bottom left of the target is drawn and blitted
+	GLsizei contentWidth = 0;
+	GLsizei contentHeight = 0;
 
-	VertexArray vao;
-	ArrayBuffer vbo;
-	ElementBuffer eab;
+	Texture2D texture;
 
 	GLuint multisampledHandle = 0;
 	std::unique_ptr<MultisampledTexture2D> multisampledTexture;
 	GLuint depthBuffer = 0;
+
+	GLsizei samples = 0;
+	GLenum depthStencilFormat = GL_NONE;
+	GLbitfield invalidateAfterBlit = 0;
+
+	struct Readback {
+		PixelPackBuffer buffer;
+		GLsync fence = nullptr;
+		ReadbackTicket ticket = 0;
+	};
+
+	std::vector<Readback> readbacks;
+	std::size_t readbackRingSize = 3;
+	ReadbackTicket nextTicket = 0;
 };
 
 using FramebufferObject = Framebuffer<false>;
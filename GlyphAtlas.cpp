@@ -0,0 +1,153 @@
+#include "GlyphAtlas.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Fetcko {
+GlyphAtlas::Page::Page(GLsizei size, int padding) :
+	texture(GL_RED, GL_RED, true),
+	packer(size, size, padding),
+	pixels(static_cast<std::size_t>(size) * size, 0),
+	dirtyTop(size) {
+	// Start out transparent so that filtering
+	// never picks up garbage around the glyphs
+	texture.TexImage2D(size, size, pixels.data());
+	texture.SetTexParameters();
+}
+
+GlyphAtlas::GlyphAtlas(GLsizei pageSize, int padding) :
+	pageSize(pageSize),
+	padding(padding) {
+
+}
+
+std::optional<GlyphAtlas::Region> GlyphAtlas::Add(GLsizei width, GLsizei height, const uint8_t *data) {
+	Region ret;
+
+	// Nothing to upload (e.g. whitespace)
+	if (width == 0 || height == 0)
+		return ret;
+
+	std::optional<ShelfPacker::Rect> rect;
+
+	// Older pages may still have room for small glyphs
+	for (auto &page : pages) {
+		if ((rect = page.packer.Pack(width, height)))
+			break;
+		++ret.page;
+	}
+
+	if (!rect) {
+		if (!Fits(width, height)) {
+			logger.LogError("Glyph of ", width, "x", height, " does not fit into a texture");
+			return std::nullopt;
+		}
+
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+		// Grow the page size for glyphs that would never fit
+		while (width + padding > pageSize || height + padding > pageSize)
+			pageSize = std::min(pageSize * 2, maxSize);
+
+		pages.emplace_back(pageSize, padding);
+		bytesUploaded += static_cast<std::size_t>(pageSize) * pageSize;
+		ret.page = pages.size() - 1;
+		rect = pages.back().packer.Pack(width, height);
+	}
+
+	auto &page = pages[ret.page];
+
+	const auto stride = page.packer.GetWidth();
+
+	for (GLsizei y = 0; y < height; ++y) {
+		std::copy_n(
+			data + static_cast<std::size_t>(y) * width,
+			width,
+			page.pixels.begin() + static_cast<std::size_t>(rect->y + y) * stride + rect->x
+		);
+	}
+
+	if (batching) {
+		page.dirtyTop = std::min(page.dirtyTop, rect->y);
+		page.dirtyBottom = std::max(page.dirtyBottom, rect->y + height);
+	} else {
+		page.texture.Bind();
+		page.texture.TexSubImage2D(rect->x, rect->y, width, height, data);
+		bytesUploaded += static_cast<std::size_t>(width) * height;
+	}
+
+	const auto size = static_cast<float>(stride);
+
+	ret.x = rect->x;
+	ret.y = rect->y;
+	ret.width = width;
+	ret.height = height;
+	ret.uv = {
+		rect->x / size,
+		rect->y / size,
+		(rect->x + width) / size,
+		(rect->y + height) / size
+	};
+
+	return ret;
+}
+
+bool GlyphAtlas::Fits(GLsizei width, GLsizei height) const {
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+	return width + padding <= maxSize && height + padding <= maxSize;
+}
+
+void GlyphAtlas::EndBatch() {
+	batching = false;
+
+	for (auto &page : pages) {
+		if (page.dirtyTop >= page.dirtyBottom)
+			continue;
+
+		const auto width = page.packer.GetWidth();
+
+		page.texture.Bind();
+		page.texture.TexSubImage2D(
+			0,
+			page.dirtyTop,
+			width,
+			page.dirtyBottom - page.dirtyTop,
+			page.pixels.data() + static_cast<std::size_t>(page.dirtyTop) * width
+		);
+
+		bytesUploaded += static_cast<std::size_t>(page.dirtyBottom - page.dirtyTop) * width;
+
+		page.dirtyTop = page.packer.GetHeight();
+		page.dirtyBottom = 0;
+	}
+}
+
+std::vector<uint8_t> GlyphAtlas::Read(std::size_t page, const glm::vec4 &uv, GLsizei width, GLsizei height) const {
+	std::vector<uint8_t> ret(static_cast<std::size_t>(width) * height);
+
+	if (ret.empty())
+		return ret;
+
+	const auto &source = pages.at(page);
+	const auto stride = source.packer.GetWidth();
+	const auto x = static_cast<int>(std::lround(uv.x * stride));
+	const auto y = static_cast<int>(std::lround(uv.y * source.packer.GetHeight()));
+
+	for (GLsizei row = 0; row < height; ++row) {
+		std::copy_n(
+			source.pixels.begin() + static_cast<std::size_t>(y + row) * stride + x,
+			width,
+			ret.begin() + static_cast<std::size_t>(row) * width
+		);
+	}
+
+	return ret;
+}
+
+void GlyphAtlas::Clear() {
+	pages.clear();
+}
+}
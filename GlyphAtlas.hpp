@@ -0,0 +1,77 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <glad/glad.h>
+
+#include "Logger.hpp"
+#include "ShelfPacker.hpp"
+#include "Texture.hpp"
+
+namespace Fetcko {
+// Single-channel texture pages that glyph bitmaps get packed into,
+// so that a whole string can be drawn without rebinding textures.
+// Pages are only allocated once the previous ones are full.
+class GlyphAtlas : public LoggableClass {
+public:
+	struct Region {
+		std::size_t page = 0;
+		int x = 0, y = 0, width = 0, height = 0;
+		glm::vec4 uv{ 0.0f };	// left, top, right, bottom
+	};
+
+	explicit GlyphAtlas(GLsizei pageSize = 1024, int padding = 2);
+
+	// Expects GL_UNPACK_ALIGNMENT to be 1
+	std::optional<Region> Add(GLsizei width, GLsizei height, const uint8_t *data);
+
+	// Whether Add() would find room for a bitmap of that size,
+	// growing the page size or adding a page if it has to
+	bool Fits(GLsizei width, GLsizei height) const;
+
+	// Glyphs added in between only go into the CPU copy of their
+	// page; EndBatch() then uploads one row band for each page
+	void BeginBatch() { batching = true; }
+	void EndBatch();
+
+	// Copies a bitmap back out of the CPU copy of its page
+	std::vector<uint8_t> Read(std::size_t page, const glm::vec4 &uv, GLsizei width, GLsizei height) const;
+
+	void Clear();
+
+	const Texture2D &GetPage(std::size_t page) const { return pages.at(page).texture; }
+	const std::size_t GetPageCount() const { return pages.size(); }
+	const GLsizei GetPageSize() const { return pageSize; }
+
+	// Texture data sent to the GPU so far, including blank pages
+	const std::size_t GetBytesUploaded() const { return bytesUploaded; }
+
+private:
+	struct Page {
+		Page(GLsizei size, int padding);
+
+		Texture2D texture;
+		ShelfPacker packer;
+
+		// CPU copy of the texture, so that batched
+		// uploads can send whole rows at once
+		std::vector<uint8_t> pixels;
+
+		// Rows touched since the last upload
+		int dirtyTop = 0;
+		int dirtyBottom = 0;
+	};
+
+	GLsizei pageSize = 1024;
+	int padding = 2;
+
+	bool batching = false;
+
+	std::size_t bytesUploaded = 0;
+
+	std::vector<Page> pages;
+};
+}
@@ -0,0 +1,155 @@
+#include "GlyphCache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Fetcko {
+GlyphCache::GlyphCache(const std::filesystem::path &directory) :
+	directory(directory) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	if (error)
+		logger.LogError("Could not create glyph cache ", directory.u8string(), ": ", error.message());
+}
+
+std::optional<GlyphCache::Contents> GlyphCache::Load(std::uint64_t key) const {
+	const auto path = GetPath(key);
+
+	std::ifstream inFile(path, std::ios::binary | std::ios::in | std::ios::ate);
+	if (!inFile)
+		return std::nullopt;
+
+	// Read it in one go and parse it from memory
+	std::vector<char> data(static_cast<std::size_t>(inFile.tellg()));
+	inFile.seekg(0);
+	inFile.read(data.data(), data.size());
+	inFile.close();
+
+	const auto discard = [&]() -> std::optional<Contents> {
+		logger.LogWarning("Discarding invalid glyph cache ", path.u8string());
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return std::nullopt;
+	};
+
+	Header header;
+	if (!inFile || data.size() < sizeof(Header))
+		return discard();
+
+	std::memcpy(&header, data.data(), sizeof(Header));
+
+	// Every glyph takes at least a record, so a count the file
+	// can't hold means it's corrupt (and not worth reserving for)
+	if (std::string_view(header.magic, 4) != std::string_view(Header().magic, 4) ||
+		header.version != Header().version ||
+		header.key != key ||
+		header.count > (data.size() - sizeof(Header)) / sizeof(Record)) {
+		return discard();
+	}
+
+	Contents ret;
+	ret.overhang = header.overhang;
+	ret.glyphs.reserve(header.count);
+
+	std::size_t offset = sizeof(Header);
+
+	for (uint32_t i = 0; i < header.count; ++i) {
+		Record record;
+		if (data.size() - offset < sizeof(Record))
+			return discard();
+
+		std::memcpy(&record, data.data() + offset, sizeof(Record));
+		offset += sizeof(Record);
+
+		const auto length = static_cast<std::size_t>(record.width) * record.height;
+		if (record.width < 0 || record.height < 0 || data.size() - offset < length)
+			return discard();
+
+		FT_Glyph_Metrics metrics{
+			static_cast<FT_Pos>(record.metrics[0]),
+			static_cast<FT_Pos>(record.metrics[1]),
+			static_cast<FT_Pos>(record.metrics[2]),
+			static_cast<FT_Pos>(record.metrics[3]),
+			static_cast<FT_Pos>(record.metrics[4]),
+			static_cast<FT_Pos>(record.metrics[5]),
+			static_cast<FT_Pos>(record.metrics[6]),
+			static_cast<FT_Pos>(record.metrics[7])
+		};
+
+		auto bitmap = reinterpret_cast<const uint8_t *>(data.data() + offset);
+		offset += length;
+
+		ret.glyphs.emplace_back(Glyph{
+			record.c,
+			glm::ivec2(record.width, record.height),
+			glm::ivec2(record.left, record.top),
+			metrics,
+			static_cast<FT_Pos>(record.advance),
+			std::vector<uint8_t>(bitmap, bitmap + length)
+		});
+	}
+
+	return ret;
+}
+
+void GlyphCache::Store(std::uint64_t key, const Contents &contents) const {
+	Header header;
+	header.key = key;
+	header.count = static_cast<uint32_t>(contents.glyphs.size());
+	header.overhang = contents.overhang;
+
+	// Write to a temporary file first so that a crash
+	// (or a second process) never sees a partial cache
+	const auto path = GetPath(key);
+	auto temporary = path;
+	temporary += ".tmp";
+
+	std::ofstream outFile(temporary, std::ios::binary | std::ios::out);
+	outFile.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+
+	for (const auto &glyph : contents.glyphs) {
+		const auto &metrics = glyph.metrics;
+
+		Record record;
+		record.c = static_cast<uint32_t>(glyph.c);
+		record.width = glyph.size.x;
+		record.height = glyph.size.y;
+		record.left = glyph.bearing.x;
+		record.top = glyph.bearing.y;
+		record.metrics[0] = metrics.width;
+		record.metrics[1] = metrics.height;
+		record.metrics[2] = metrics.horiBearingX;
+		record.metrics[3] = metrics.horiBearingY;
+		record.metrics[4] = metrics.horiAdvance;
+		record.metrics[5] = metrics.vertBearingX;
+		record.metrics[6] = metrics.vertBearingY;
+		record.metrics[7] = metrics.vertAdvance;
+		record.advance = glyph.advance;
+
+		outFile.write(reinterpret_cast<const char *>(&record), sizeof(Record));
+		outFile.write(reinterpret_cast<const char *>(glyph.bitmap.data()), glyph.bitmap.size());
+	}
+
+	outFile.close();
+
+	std::error_code error;
+
+	if (outFile)
+		std::filesystem::rename(temporary, path, error);
+
+	if (!outFile || error) {
+		logger.LogWarning("Could not store glyph cache ", path.u8string());
+		std::filesystem::remove(temporary, error);
+	}
+}
+
+std::filesystem::path GlyphCache::GetPath(std::uint64_t key) const {
+	std::stringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << key << ".glyphs";
+
+	return directory / name.str();
+}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "Logger.hpp"
+
+namespace Fetcko {
+// Keeps rasterized glyphs on disk so that fonts can skip
+// FreeType entirely for glyphs a previous run has seen.
+//
+// Each file holds one font configuration (see OpenGLFont's
+// cache key) and is stored as <directory>/<key>.glyphs.
+class GlyphCache : public LoggableClass {
+public:
+	// Glyph bitmap straight out of FreeType, before it goes into an atlas
+	struct Glyph {
+		FT_ULong c;
+		glm::ivec2 size;
+		glm::ivec2 bearing;
+		FT_Glyph_Metrics metrics;
+		FT_Pos advance;
+		std::vector<uint8_t> bitmap;	// Tightly packed
+	};
+
+	struct Contents {
+		int overhang = 0;
+		std::vector<Glyph> glyphs;
+	};
+
+	explicit GlyphCache(const std::filesystem::path &directory);
+
+	std::optional<Contents> Load(std::uint64_t key) const;
+	void Store(std::uint64_t key, const Contents &contents) const;
+
+private:
+#pragma pack (push, 1)
+	struct [[gnu::packed]] Header {
+		char magic[4] = { 'F', 'G', 'L', 'C' };
+		uint32_t version = 1;
+		uint64_t key = 0;
+		uint32_t count = 0;
+		int32_t overhang = 0;
+	};
+
+	// Followed by width * height bytes of bitmap
+	struct [[gnu::packed]] Record {
+		uint32_t c = 0;
+		int32_t width = 0, height = 0;
+		int32_t left = 0, top = 0;
+		int64_t metrics[8] = {};
+		int64_t advance = 0;
+	};
+#pragma pack (pop)
+
+	std::filesystem::path GetPath(std::uint64_t key) const;
+
+	std::filesystem::path directory;
+};
+}
@@ -0,0 +1,275 @@
+#include "HeadlessContext.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <EGL/eglext.h>
+
+#include <glad/glad.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <lodepng.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace Fetcko {
+namespace {
+// Unsets the variable for a null value
+void SetEnvironment(const char *name, const char *value) {
+#ifdef _WIN32
+	_putenv_s(name, value ? value : "");
+#else
+	if (value)
+		setenv(name, value, 1);
+	else
+		unsetenv(name);
+#endif
+}
+}
+
+bool HeadlessContext::Image::SaveAsPNG(const std::filesystem::path &path) const {
+	return lodepng::encode(path.u8string(), pixels, width, height) == 0;
+}
+
+HeadlessContext::~HeadlessContext() {
+	OnDestroy();
+
+	if (display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	if (eglContext != EGL_NO_CONTEXT)
+		eglDestroyContext(display, eglContext);
+	if (surface != EGL_NO_SURFACE)
+		eglDestroySurface(display, surface);
+
+	eglTerminate(display);
+}
+
+bool HeadlessContext::Init(bool software) {
+	// Mesa's EGL reads this when the display gets initialized. It's the
+	// whole process's environment though, so it's left alone if already
+	// set, and only set until then otherwise.
+	const auto forceSoftware = software && !std::getenv("LIBGL_ALWAYS_SOFTWARE");
+
+	if (forceSoftware)
+		SetEnvironment("LIBGL_ALWAYS_SOFTWARE", "1");
+
+	// Without a display server, Mesa can still give us a surfaceless platform
+	const auto clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	if (HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless") &&
+		HasExtension(clientExtensions, "EGL_EXT_platform_base")) {
+		const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+			eglGetProcAddress("eglGetPlatformDisplayEXT")
+		);
+
+		if (getPlatformDisplay)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	const auto initialized = display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor);
+
+	if (forceSoftware)
+		SetEnvironment("LIBGL_ALWAYS_SOFTWARE", nullptr);
+
+	if (!initialized) {
+		logger.LogError("Could not initialize an EGL display");
+		display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	logger.LogInfo("EGL ", major, ".", minor, " (", eglQueryString(display, EGL_VENDOR), ")");
+
+	const auto surfaceless = HasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0) {
+		logger.LogError("No suitable EGL config");
+		return false;
+	}
+
+	// We never draw to it, framebuffers are what we render into
+	if (!surfaceless) {
+		const EGLint surfaceAttributes[] = {
+			EGL_WIDTH, 1,
+			EGL_HEIGHT, 1,
+			EGL_NONE
+		};
+
+		surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+		if (surface == EGL_NO_SURFACE) {
+			logger.LogError("Could not create an EGL pbuffer");
+			return false;
+		}
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		logger.LogError("EGL does not support OpenGL");
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	eglContext = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT) {
+		logger.LogError("Could not create an OpenGL 3.3 context");
+		return false;
+	}
+
+	if (!MakeCurrent())
+		return false;
+
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+		logger.LogError("Could not load OpenGL");
+		return false;
+	}
+
+	logger.LogInfo("Rendering with ", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	context = std::make_unique<Context>();
+	pool = std::make_unique<RenderTargetPool>();
+
+	return true;
+}
+
+void HeadlessContext::OnDestroy() {
+	pool.reset();
+	context.reset();
+}
+
+bool HeadlessContext::MakeCurrent() {
+	if (!eglMakeCurrent(display, surface, surface, eglContext)) {
+		logger.LogError("Could not make the EGL context current");
+		return false;
+	}
+
+	return true;
+}
+
+bool HeadlessContext::Render(const Job &job, Image &image) {
+	if (!pool) {
+		logger.LogError("Render() called before Init()");
+		return false;
+	}
+
+	if (job.width <= 0 || job.height <= 0) {
+		logger.LogError("Invalid image size ", job.width, "x", job.height);
+		return false;
+	}
+
+	// Whatever went wrong before isn't this job's fault
+	while (glGetError() != GL_NO_ERROR);
+
+	auto target = pool->Acquire(job.width, job.height);
+	if (!target)
+		return false;
+
+	target.BeginRender();
+
+	glClearColor(job.background.x, job.background.y, job.background.z, job.background.w);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	const auto projection = glm::ortho(0.0f, static_cast<float>(job.width), static_cast<float>(job.height), 0.0f);
+	context->SetIdentity(glm::mat4(projection));
+
+	if (job.render)
+		job.render(*context, projection);
+
+	// The job may have rendered into something else along the way
+	// (e.g. caching text), so read back from the target regardless
+	target->Bind();
+
+	image.width = job.width;
+	image.height = job.height;
+	image.pixels.resize(static_cast<std::size_t>(job.width) * job.height * 4);
+
+	GLint previousPackAlignment = 0;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &previousPackAlignment);
+
+	// Straight from the framebuffer, as the target is likely bigger than the job
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, job.width, job.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+
+	glPixelStorei(GL_PACK_ALIGNMENT, previousPackAlignment);
+
+	target.EndRender();
+
+	// OpenGL's rows go bottom-up
+	const auto stride = static_cast<std::size_t>(job.width) * 4;
+	for (GLsizei y = 0; y < job.height / 2; ++y) {
+		std::swap_ranges(
+			image.pixels.begin() + y * stride,
+			image.pixels.begin() + (y + 1) * stride,
+			image.pixels.begin() + (job.height - 1 - y) * stride
+		);
+	}
+
+	if (auto error = glGetError(); error != GL_NO_ERROR) {
+		logger.LogError("OpenGL error ", error, " while rendering a job");
+
+		// Nor should the next job get blamed for any others
+		while (glGetError() != GL_NO_ERROR);
+
+		return false;
+	}
+
+	return true;
+}
+
+bool HeadlessContext::Render(const std::vector<Job> &jobs, std::vector<Image> &images) {
+	images.resize(jobs.size());
+
+	for (std::size_t i = 0; i < jobs.size(); ++i) {
+		if (!Render(jobs[i], images[i])) {
+			images.resize(i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool HeadlessContext::HasExtension(const char *extensions, const char *name) const {
+	if (!extensions)
+		return false;
+
+	const auto length = std::strlen(name);
+
+	for (auto iter = std::strstr(extensions, name); iter; iter = std::strstr(iter + length, name)) {
+		const auto end = iter[length];
+
+		if ((iter == extensions || iter[-1] == ' ') && (end == ' ' || end == '\0'))
+			return true;
+	}
+
+	return false;
+}
+}
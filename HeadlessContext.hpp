@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include <EGL/egl.h>
+
+#include <glm/glm.hpp>
+
+#include "Context.hpp"
+#include "Logger.hpp"
+#include "RenderTargetPool.hpp"
+
+namespace Fetcko {
+// Sets up OpenGL without a window, through EGL, for rendering images on
+// servers. Uses a surfaceless context where the driver allows it and a
+// tiny pbuffer otherwise, so jobs always render into framebuffers.
+//
+// Shaders registered with GetContext() and fonts or meshes loaded after
+// Init() stay alive across jobs, as do the render targets, so a batch
+// only pays for setting up once.
+class HeadlessContext : public LoggableClass {
+public:
+	struct Job {
+		GLsizei width = 0;
+		GLsizei height = 0;
+		glm::vec4 background{ 0.0f };
+
+		// Draws the scene. The projection maps pixels with the origin
+		// at the top left, and is also the context's identity.
+		std::function<void(Context &context, const glm::mat4 &projection)> render;
+	};
+
+	struct Image {
+		GLsizei width = 0;
+		GLsizei height = 0;
+
+		// RGBA, top row first
+		std::vector<uint8_t> pixels;
+
+		bool SaveAsPNG(const std::filesystem::path &path) const;
+	};
+
+	HeadlessContext() = default;
+	HeadlessContext(const HeadlessContext &) = delete;
+	~HeadlessContext();
+
+	// Creates an OpenGL 3.3 core context and loads it with glad.
+	// With software, Mesa is asked for its software rasterizer,
+	// which also works on machines without a GPU. That goes through
+	// LIBGL_ALWAYS_SOFTWARE, which is only set while the display gets
+	// initialized, and not at all if the environment already has it.
+	bool Init(bool software = false);
+
+	// Releases the shaders and render targets. Anything else
+	// GL related has to be destroyed before this, too.
+	void OnDestroy();
+
+	// For when another context was made current in between
+	bool MakeCurrent();
+
+	bool Render(const Job &job, Image &image);
+
+	// Renders the jobs in order, stopping at the first failure
+	bool Render(const std::vector<Job> &jobs, std::vector<Image> &images);
+
+	Context &GetContext() { return *context; }
+	RenderTargetPool &GetRenderTargetPool() { return *pool; }
+
+private:
+	bool HasExtension(const char *extensions, const char *name) const;
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLSurface surface = EGL_NO_SURFACE;
+	EGLContext eglContext = EGL_NO_CONTEXT;
+
+	// Both need to go before the EGL context does
+	std::unique_ptr<Context> context;
+	std::unique_ptr<RenderTargetPool> pool;
+};
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace Fetcko {
+// Bounded map that evicts the least recently used entry
+// once full, keeping hit / miss counters along the way
+template<
+	typename Key,
+	typename Value,
+	typename Hash = std::hash<Key>
+>
+class LruCache {
+public:
+	struct Statistics {
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t evictions = 0;
+
+		const float GetHitRate() const {
+			return hits + misses > 0 ? static_cast<float>(hits) / (hits + misses) : 0.0f;
+		}
+	};
+
+	explicit LruCache(std::size_t capacity = 1024) : capacity(capacity) {}
+
+	// Marks the entry as the most recently used one
+	Value *Find(const Key &key) {
+		auto iter = lookup.find(key);
+
+		if (iter == lookup.end()) {
+			++statistics.misses;
+			return nullptr;
+		}
+
+		++statistics.hits;
+		entries.splice(entries.begin(), entries, iter->second);
+
+		return &iter->second->second;
+	}
+
+	Value &Insert(const Key &key, Value &&value) {
+		if (auto iter = lookup.find(key); iter != lookup.end()) {
+			iter->second->second = std::move(value);
+			entries.splice(entries.begin(), entries, iter->second);
+			return iter->second->second;
+		}
+
+		Trim(capacity > 0 ? capacity - 1 : 0);
+
+		entries.emplace_front(key, std::move(value));
+		lookup.emplace(key, entries.begin());
+
+		return entries.front().second;
+	}
+
+	// Statistics are kept, since they describe the workload
+	void Clear() {
+		entries.clear();
+		lookup.clear();
+	}
+
+	void SetCapacity(std::size_t capacity) {
+		this->capacity = capacity;
+		Trim(capacity);
+	}
+
+	const std::size_t GetCapacity() const { return capacity; }
+	const std::size_t GetSize() const { return entries.size(); }
+
+	const Statistics &GetStatistics() const { return statistics; }
+	void ResetStatistics() { statistics = Statistics(); }
+
+private:
+	void Trim(std::size_t size) {
+		while (entries.size() > size) {
+			lookup.erase(entries.back().first);
+			entries.pop_back();
+			++statistics.evictions;
+		}
+	}
+
+	std::size_t capacity = 1024;
+
+	std::list<std::pair<Key, Value>> entries;
+	std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> lookup;
+
+	Statistics statistics;
+};
+}
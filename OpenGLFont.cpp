@@ -1,156 +1,395 @@
 #include "OpenGLFont.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
 #include <freetype/ftbitmap.h>
+#include <freetype/ftmodapi.h>
+#include <freetype/ftsizes.h>
 
 #include <glm/glm.hpp>
 
+#include "Fnv1a.hpp"
 #include "Hash.hpp"
+#include "ThreadPool.hpp"
+#include "Utf8.hpp"
 
 namespace Fetcko {
-glm::vec3 OpenGLFont::lastColor = {
-		std::numeric_limits<float>::infinity(),
-		std::numeric_limits<float>::infinity(),
-		std::numeric_limits<float>::infinity()
-};
-
-std::map<FT_ULong, OpenGLFont::Character>::iterator OpenGLFont::LoadGlyph(std::size_t i, const FT_ULong c) {
-	auto face = faces.begin();
-
-	auto index = FT_Get_Char_Index(*face, c);
-	while (index == 0) {
-		if (++face == faces.end()) {
-			--face;
-			break;
-		}
+OpenGLFont::Rasterizer::Rasterizer(const OpenGLFont &font) :
+	renderMode(font.renderMode) {
+	if (FT_Init_FreeType(&ft)) {
+		ft = nullptr;
+		return;
+	}
 
-		index = FT_Get_Char_Index(*face, c);
+	font.SetLibraryProperties(ft);
+
+	for (const auto &data : font.fontData) {
+		FT_Face face = nullptr;
+		if (FT_New_Memory_Face(ft, data.data(), static_cast<FT_Long>(data.size()), 0, &face))
+			return;
+
+		FT_Set_Pixel_Sizes(face, 0, font.GetPixelSize());
+		faces.emplace_back(face);
 	}
 
-	// load character glyph 
-	if (FT_Load_Glyph(*face, index, FT_LOAD_DEFAULT)) {
-		logger.LogError("Failed to load Glyph");
-		return characters.end();
+	if (font.stroker) {
+		FT_Stroker_New(ft, &stroker);
+		font.SetStrokerProperties(stroker);
 	}
 
+	valid = true;
+}
+
+OpenGLFont::Rasterizer::~Rasterizer() {
+	FT_Stroker_Done(stroker);
+
+	for (auto face : faces)
+		FT_Done_Face(face);
+
+	FT_Done_FreeType(ft);
+}
+
+std::optional<OpenGLFont::RasterizedGlyph> OpenGLFont::Rasterize(
+	const FT_ULong c,
+	const std::vector<FT_Face> &faces,
+	const CoverageIndex &coverage,
+	FT_Stroker stroker,
+	RenderMode renderMode
+) {
+	// Nobody has it, so we get the last face's .notdef glyph
+	auto face = faces.at(coverage.Find(c).value_or(faces.size() - 1));
+	auto index = FT_Get_Char_Index(face, c);
+
+	// load character glyph 
+	if (FT_Load_Glyph(face, index, FT_LOAD_DEFAULT))
+		return std::nullopt;
+
 	FT_BitmapGlyph glyph = nullptr;
 	{
 		FT_Glyph _glyph;
-		auto error = FT_Get_Glyph((*face)->glyph, &_glyph);
+		auto error = FT_Get_Glyph(face->glyph, &_glyph);
 
 		if (stroker)
 			error = FT_Glyph_StrokeBorder(&_glyph, stroker, false, true);
 
-		error = FT_Glyph_To_Bitmap(&_glyph, FT_RENDER_MODE_LCD, nullptr, true);
+		error = FT_Glyph_To_Bitmap(
+			&_glyph,
+			renderMode == RenderMode::Sdf ? FT_RENDER_MODE_SDF : FT_RENDER_MODE_LCD,
+			nullptr,
+			true
+		);
 
 		glyph = reinterpret_cast<FT_BitmapGlyph>(_glyph);
 	}
 
-	float x = 0.0f, y = 0.0f, w = 0.0f, h = 0.0f;
+	RasterizedGlyph ret{
+		c,
+		glm::ivec2(glyph->bitmap.width, glyph->bitmap.rows),
+		glm::ivec2(glyph->left, glyph->top),
+		face->glyph->metrics,
+		face->glyph->advance.x >> 6
+	};
 
 	// tightly pack
-	std::vector<uint8_t> packed(glyph->bitmap.width * glyph->bitmap.rows);
+	ret.bitmap.resize(glyph->bitmap.width * glyph->bitmap.rows);
 	for (unsigned int y = 0; y < glyph->bitmap.rows; ++y) {
 		for (unsigned int x = 0; x < glyph->bitmap.width; ++x) {
-			packed[y * glyph->bitmap.width + x] = glyph->bitmap.buffer[
+			ret.bitmap[y * glyph->bitmap.width + x] = glyph->bitmap.buffer[
 				y * glyph->bitmap.pitch + x
 			];
 		}
 	}
 
-	// generate texture
-	Texture2D texture(GL_RED, GL_RED, true);
-	texture.TexImage2D(
-		glyph->bitmap.width,
-		glyph->bitmap.rows,
-		packed.data()
+	FT_Done_Glyph(reinterpret_cast<FT_Glyph>(glyph));
+
+	return ret;
+}
+
+const OpenGLFont::Character *OpenGLFont::CommitGlyph(const RasterizedGlyph &glyph) {
+	// pack into the atlas
+	auto region = atlas.Add(
+		glyph.size.x,
+		glyph.size.y,
+		glyph.bitmap.data()
 	);
 
-	// set texture options
-	texture.SetTexParameters();
+	if (!region)
+		return nullptr;
 
 	// Find max overhang below the baseline
-	if (((*face)->glyph->metrics.height / 64.0 - (*face)->glyph->metrics.horiBearingY / 64.0) > overhang)
-		overhang = ((*face)->glyph->metrics.height / 64.0 - (*face)->glyph->metrics.horiBearingY / 64.0);
+	if ((glyph.metrics.height / 64.0 - glyph.metrics.horiBearingY / 64.0) > glyphs->overhang) {
+		glyphs->overhang = (glyph.metrics.height / 64.0 - glyph.metrics.horiBearingY / 64.0);
+
+		// Cached heights depend on it
+		glyphs->layouts.Clear();
+	}
 
 	// now store character for later use
-	const auto &ret = characters.emplace(
-		c,
+	const auto ret = &glyphs->characters.emplace(
+		glyph.c,
 		Character{
-			static_cast<GLint>(i),
-			std::move(texture),
-			glm::ivec2(glyph->bitmap.width, glyph->bitmap.rows),
-			glm::ivec2(glyph->left, glyph->top),
-			(*face)->glyph->metrics,
-			(*face)->glyph->advance.x >> 6
+			region->page,
+			std::move(region->uv),
+			glm::ivec2(glyph.size),
+			glm::ivec2(glyph.bearing),
+			glyph.metrics,
+			FT_Pos(glyph.advance)
 		}
-	).first;
+	).first->second;
 
-	FT_Done_Glyph(reinterpret_cast<FT_Glyph>(glyph));
+	if (glyph.c < glyphs->latin.size())
+		glyphs->latin[glyph.c] = ret;
 
-	const auto &ch = ret->second;
+	return ret;
+}
 
-	x = static_cast<float>(ch.bearing.x);
-	y = static_cast<float>(-ch.bearing.y);
+const OpenGLFont::Character *OpenGLFont::LoadGlyph(const FT_ULong c) {
+	auto glyph = Rasterize(c, faces, coverage, stroker, renderMode);
 
-	w = static_cast<float>(ch.size.x / 3);
-	//w = static_cast<float>(ch.size.x);
-	h = static_cast<float>(ch.size.y);
+	if (!glyph) {
+		logger.LogError("Failed to load Glyph");
+		return nullptr;
+	}
 
-	// update VBO for each character
-	float vertices[6][4] = {
-		{ x,     y,     0.0f, 0.0f },
-		{ x,     y + h, 0.0f, 1.0f },
-		{ x + w, y + h, 1.0f, 1.0f },
+	return CommitGlyph(*glyph);
+}
 
-		{ x,     y,     0.0f, 0.0f },
-		{ x + w, y + h, 1.0f, 1.0f },
-		{ x + w, y,     1.0f, 0.0f }
-	};
+inline bool OpenGLFont::LoadInitialCharacters() {
+	if (LoadCachedGlyphs()) {
+		glyphs->em = MeasureText("M");
+		return true;
+	}
 
-	vbo.BufferSubData(i * 6 * 4, sizeof(vertices), vertices);
+	// Each worker gets its own FreeType library, faces and
+	// stroker (none of which are thread safe) and rasterizes
+	// a slice of the set; we then upload everything at once
+	ThreadPool pool(std::min<std::size_t>(std::thread::hardware_concurrency(), 4));
 
-	return ret;
-}
+	const auto slices = pool.GetThreadCount();
+	const auto sliceSize = (CharacterSet.size() + slices - 1) / slices;
 
-inline bool OpenGLFont::LoadInitialCharacters() {
-	vao.Bind();
-	vbo.Bind();
-	vbo.BufferData(sizeof(float) * 6 * 4 * CharacterSet.size());
-	vao.AddAttribute(VertexArray::Attribute(0, 2, 4 * sizeof(float)));
-	vao.AddAttribute(VertexArray::Attribute(1, 2, 4 * sizeof(float), 2 * sizeof(float)));
+	std::vector<std::future<std::optional<std::vector<RasterizedGlyph>>>> results;
+
+	for (std::size_t start = 0; start < CharacterSet.size(); start += sliceSize) {
+		results.emplace_back(pool.Submit([this, slice = CharacterSet.substr(start, sliceSize)]() -> std::optional<std::vector<RasterizedGlyph>> {
+			Rasterizer rasterizer(*this);
+			if (!rasterizer.valid)
+				return std::nullopt;
+
+			std::vector<RasterizedGlyph> ret;
+			ret.reserve(slice.size());
+
+			for (const auto c : slice) {
+				auto glyph = Rasterize(static_cast<FT_ULong>(c), rasterizer.faces, coverage, rasterizer.stroker, rasterizer.renderMode);
+				if (!glyph)
+					return std::nullopt;
+
+				ret.emplace_back(std::move(*glyph));
+			}
+
+			return ret;
+		}));
+	}
 
 	GLint previousUnpackAlignment = 0;
 	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousUnpackAlignment);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // disable byte-alignment restriction
 
-	for (const auto &[i, c] : Utils::Enumerate(CharacterSet)) {
-		if (LoadGlyph(i, c) == characters.end()) {
-			glPixelStorei(GL_UNPACK_ALIGNMENT, previousUnpackAlignment);
+	atlas.BeginBatch();
+
+	// Committed in order, so the atlas layout doesn't depend on timing
+	auto ret = true;
+	GlyphCache::Contents cached;
+	for (auto &result : results) {
+		auto rasterized = result.get();
+
+		if (!rasterized) {
+			logger.LogError("Failed to rasterize the initial characters");
+			ret = false;
+			continue;
+		}
+
+		for (auto &glyph : *rasterized) {
+			if (!CommitGlyph(glyph))
+				ret = false;
+			else if (glyphCache)
+				cached.glyphs.emplace_back(std::move(glyph));
+		}
+	}
+
+	atlas.EndBatch();
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, previousUnpackAlignment);
+
+	if (!ret)
+		return false;
+
+	if (glyphCache) {
+		cached.overhang = glyphs->overhang;
+		glyphCache->Store(GetGlyphCacheKey(), cached);
+	}
+
+	glyphs->em = MeasureText("M");
+
+	return true;
+}
+
+bool OpenGLFont::LoadCachedGlyphs() {
+	if (!glyphCache)
+		return false;
+
+	auto cached = glyphCache->Load(GetGlyphCacheKey());
+	if (!cached)
+		return false;
+
+	// Checked up front, as the atlas can't take glyphs back out
+	// once they're in, and other sizes share it
+	for (const auto &glyph : cached->glyphs) {
+		if (!atlas.Fits(glyph.size.x, glyph.size.y)) {
+			logger.LogWarning("Could not fit the cached glyphs, rasterizing them instead");
 			return false;
 		}
 	}
 
-	vbo.Unbind();
-	vao.Unbind();
+	GLint previousUnpackAlignment = 0;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousUnpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // disable byte-alignment restriction
+
+	atlas.BeginBatch();
+
+	for (const auto &glyph : cached->glyphs)
+		CommitGlyph(glyph);
+
+	atlas.EndBatch();
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, previousUnpackAlignment);
 
-	em = MeasureText("M");
+	glyphs->overhang = std::max(glyphs->overhang, cached->overhang);
+	glyphs->layouts.Clear();
+
+	return true;
+}
+
+void OpenGLFont::SaveGlyphCache() {
+	if (!glyphCache || !glyphs)
+		return;
+
+	GlyphCache::Contents contents;
+	contents.overhang = glyphs->overhang;
+	contents.glyphs.reserve(glyphs->characters.size());
+
+	for (const auto &[c, character] : glyphs->characters) {
+		// Characters keep these in whole pixels
+		auto metrics = character.metrics;
+		metrics.height <<= 6;
+		metrics.horiBearingY <<= 6;
+
+		contents.glyphs.emplace_back(RasterizedGlyph{
+			c,
+			character.size,
+			character.bearing,
+			metrics,
+			character.advance,
+			atlas.Read(character.page, character.uv, character.size.x, character.size.y)
+		});
+	}
+
+	glyphCache->Store(GetGlyphCacheKey(), contents);
+}
+
+std::uint64_t OpenGLFont::GetGlyphCacheKey() const {
+	const auto pixelSize = GetPixelSize();
+	const auto mode = static_cast<int>(renderMode);
+	const auto spread = SdfSpread;
+
+	// Distance fields are never stroked, the shader draws their outline
+	const auto strokeRadius = renderMode == RenderMode::Sdf ? 0 : outlineRadius;
+
+	auto key = Fnv1a::Hash(&pixelSize, sizeof(pixelSize), fontHash);
+	key = Fnv1a::Hash(&strokeRadius, sizeof(strokeRadius), key);
+	key = Fnv1a::Hash(&mode, sizeof(mode), key);
+	key = Fnv1a::Hash(&spread, sizeof(spread), key);
+
+	return key;
+}
+
+void OpenGLFont::SetLibraryProperties(FT_Library library) const {
+	if (renderMode == RenderMode::Sdf) {
+		// Both the outline and the bitmap based SDF renderers
+		FT_Int spread = SdfSpread;
+		FT_Property_Set(library, "sdf", "spread", &spread);
+		FT_Property_Set(library, "bsdf", "spread", &spread);
+	}
+}
+
+void OpenGLFont::SetStrokerProperties(FT_Stroker stroker) const {
+	FT_Stroker_Set(stroker, static_cast<FT_Fixed>(outlineRadius * 64), FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0);
+}
+
+float OpenGLFont::GetSdfOutline() const {
+	// FreeType maps a distance of SdfSpread reference pixels to 0.5, and
+	// the last pixel of the spread stays clear for the antialiasing
+	const auto radius = std::min(outlineRadius / GetGlyphScale(), static_cast<float>(SdfSpread - 1));
+
+	return std::max(radius, 0.0f) / (2.0f * SdfSpread);
+}
+
+bool OpenGLFont::LoadFaces() {
+	fontData.resize(fonts.size());
+	faces.resize(fonts.size());
+
+	for (const auto &[i, font] : Utils::Enumerate(fonts)) {
+		std::ifstream file(Utils::GetResource(font), std::ios::binary);
+		fontData[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+		if (fontData[i].empty() || FT_New_Memory_Face(
+			ft,
+			fontData[i].data(),
+			static_cast<FT_Long>(fontData[i].size()),
+			0,
+			&faces[i]
+		)) {
+			logger.LogError("Failed to load font ", font);
+			faces.resize(i);
+			return false;
+		}
+
+		// Keys the glyph cache, so edited fonts don't pick up stale glyphs
+		fontHash = Fnv1a::Hash(fontData[i].data(), fontData[i].size(), fontHash);
+	}
+
+	coverage.Build(faces);
 
 	return true;
 }
 
-bool OpenGLFont::OnInit(const std::vector<std::string> &fonts, FT_UInt size, int outline) {
+bool OpenGLFont::OnInit(const std::vector<std::string> &fonts, FT_UInt size, int outline, RenderMode mode) {
 	if (FT_Init_FreeType(&ft)) {
 		logger.LogError("Could not init FreeType Library");
 		return false;
 	}
 
 	this->fonts = fonts;
+	renderMode = mode;
 
-	faces.resize(fonts.size());
+	SetLibraryProperties(ft);
+
+	if (!LoadFaces())
+		return false;
+
+	// Glyph quads get streamed in by FlushText()
+	vao.Bind();
+	vbo.Bind();
+	vao.AddAttribute(VertexArray::Attribute(0, 2, VertexSize * sizeof(float)));
+	vao.AddAttribute(VertexArray::Attribute(1, 2, VertexSize * sizeof(float), 2 * sizeof(float)));
+	vao.AddAttribute(VertexArray::Attribute(2, 3, VertexSize * sizeof(float), 4 * sizeof(float)));
+	vbo.Unbind();
+	vao.Unbind();
 
-	SetFontSize(size);
+	if (!SetFontSize(size))
+		return false;
 
 	if (outline > 0)
 		SetOutlineRadius(outline);
@@ -161,7 +400,7 @@ bool OpenGLFont::OnInit(const std::vector<std::string> &fonts, FT_UInt size, int
 	return true;
 }
 
-bool OpenGLFont::OnInit(const std::string &rootFont, FT_UInt size, int outline) {
+bool OpenGLFont::OnInit(const std::string &rootFont, FT_UInt size, int outline, RenderMode mode) {
 	std::vector<std::string> fontFiles;
 
 	// Find all fonts that start with rootFont
@@ -177,123 +416,231 @@ bool OpenGLFont::OnInit(const std::string &rootFont, FT_UInt size, int outline)
 		return false;
 	}
 
-	return OnInit(fontFiles, size, outline);
+	return OnInit(fontFiles, size, outline, mode);
 }
 
 bool OpenGLFont::SetFontSize(FT_UInt size) {
-	for (auto face : faces)
-		FT_Done_Face(face);
+	// Distance fields scale, so there's nothing to re-rasterize
+	if (renderMode == RenderMode::Sdf && glyphs) {
+		fontSize = size;
+		glyphs->layouts.Clear();
 
-	for (const auto &[i, font] : Utils::Enumerate(fonts)) {
-		auto path = Utils::GetResource(font).u8string();
-		if (FT_New_Face(ft, path.c_str(), 0, &faces[i])) {
-			logger.LogError("Failed to load font ", font);
+		if (!glyphs->characters.empty())
+			glyphs->em = MeasureText("M");
+
+		return true;
+	}
+
+	fontSize = size;
+	const auto pixelSize = GetPixelSize();
+
+	// Sizes we've seen before only need to be activated again
+	if (auto iter = glyphSets.find(pixelSize); iter != glyphSets.end()) {
+		for (const auto &[i, face] : Utils::Enumerate(faces))
+			FT_Activate_Size(iter->second.sizes[i]);
+
+		glyphs = &iter->second;
+
+		return true;
+	}
+
+	GlyphSet glyphSet;
+	glyphSet.layouts.SetCapacity(layoutCacheCapacity);
+
+	for (auto face : faces) {
+		FT_Size ftSize = nullptr;
+		if (FT_New_Size(face, &ftSize)) {
+			logger.LogError("Failed to create size ", pixelSize, " for ", face->family_name);
 			return false;
 		}
 
-		FT_Set_Pixel_Sizes(faces[i], 0, size);
+		// Sizes belong to their face and are freed along with it
+		glyphSet.sizes.emplace_back(ftSize);
+
+		FT_Activate_Size(ftSize);
+		FT_Set_Pixel_Sizes(face, 0, pixelSize);
 	}
 
-	// Flush any characters we have
-	characters.clear();
+	glyphs = &glyphSets.emplace(pixelSize, std::move(glyphSet)).first->second;
+
+	// OnInit() measures the first one itself, once the outline is set
+	if (glyphSets.size() > 1) {
+		LoadCachedGlyphs();
+		glyphs->em = MeasureText("M");
+	}
 
 	return true;
 }
 
 void OpenGLFont::SetOutlineRadius(int radius) {
+	outlineRadius = radius;
+
+	// The distance fields stay the same, the shader takes care of it
+	if (renderMode == RenderMode::Sdf) {
+		if (glyphs) {
+			glyphs->layouts.Clear();
+
+			if (!glyphs->characters.empty())
+				glyphs->em = MeasureText("M");
+		}
+
+		return;
+	}
+
 	FT_Stroker_Done(stroker);
 
 	FT_Stroker_New(ft, &stroker);
-	FT_Stroker_Set(stroker, radius * 64, FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0);
-	outlineRadius = radius;
+	SetStrokerProperties(stroker);
 
 	// Flush any characters we have
-	characters.clear();
+	ClearGlyphs();
+}
+
+void OpenGLFont::SetLayoutCacheCapacity(std::size_t capacity) {
+	layoutCacheCapacity = capacity;
+
+	for (auto &[size, glyphSet] : glyphSets)
+		glyphSet.layouts.SetCapacity(capacity);
+}
+
+void OpenGLFont::ClearGlyphs() {
+	// Every size shares the atlas, so they all go
+	for (auto &[size, glyphSet] : glyphSets) {
+		glyphSet.characters.clear();
+		glyphSet.latin.fill(nullptr);
+		glyphSet.layouts.Clear();
+		glyphSet.overhang = 0;
+	}
+
+	atlas.Clear();
+	batches.clear();
 }
 
 void OpenGLFont::OnDestroy() {
 	FT_Stroker_Done(stroker);
+	stroker = nullptr;
 
+	// Also frees every FT_Size we created
 	for (auto face : faces)
 		FT_Done_Face(face);
 
+	faces.clear();
+	fontData.clear();
+	coverage.Clear();
+
+	glyphSets.clear();
+	glyphs = nullptr;
+
 	FT_Done_FreeType(ft);
 }
 
-std::map<FT_ULong, OpenGLFont::Character>::iterator OpenGLFont::LoadMissingGlyph(const FT_ULong c) {
+const OpenGLFont::Character *OpenGLFont::LoadMissingGlyph(const FT_ULong c) {
 	GLint previousUnpackAlignment = 0;
 	glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousUnpackAlignment);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // disable byte-alignment restriction
 
-	vbo.Bind();
-
-	// FIXME: is there a more efficient way to do this?
-	auto data = vbo.GetBufferSubData(0, 6 * 4 * characters.size());
-	vbo.BufferData(sizeof(float) * 6 * 4 * (characters.size() + 1));
-	vbo.BufferSubData(0, 6 * 4 * characters.size() * sizeof(float), data.data());
-
-	auto ret = LoadGlyph(characters.size(), c);
+	auto ret = LoadGlyph(c);
 
 	glPixelStorei(GL_UNPACK_ALIGNMENT, previousUnpackAlignment);
 
-	vbo.Unbind();
-
 	return ret;
 }
 
 OpenGLFont::Bounds OpenGLFont::MeasureText(const std::string &text, float scale) {
-	Bounds ret;
+	return GetLayout(text, scale).bounds;
+}
 
-	ret.height = ((*faces.begin())->size->metrics.height >> 6) + outlineRadius * 2;
-	ret.height -= overhang / 2;
+const OpenGLFont::Layout &OpenGLFont::GetLayout(const std::string &text, float scale) {
+	auto key = Fnv1a::Hash(text);
+	key = Fnv1a::Hash(&scale, sizeof(scale), key);
+	key = Fnv1a::Hash(&fontSize, sizeof(fontSize), key);
+	key = Fnv1a::Hash(&outlineRadius, sizeof(outlineRadius), key);
 
-	const auto converted = converter.from_bytes(text);
+	// Guard against hash collisions
+	if (auto layout = glyphs->layouts.Find(key); layout && layout->text == text)
+		return *layout;
 
-	for (const auto &c : converted) {
+	Layout layout;
+	layout.text = text;
+
+	auto &ret = layout.bounds;
+
+	// Glyphs are stored at the reference size in SDF mode
+	const auto glyphScale = GetGlyphScale();
+	scale *= glyphScale;
+
+	ret.height = std::ceil(((*faces.begin())->size->metrics.height >> 6) * glyphScale) + outlineRadius * 2;
+	ret.height -= std::ceil(glyphs->overhang * glyphScale) / 2;
+
+	float x = 0.0f;
+
+	for (const auto c : Utf8(text)) {
 		// FIXME: ID3 Unicode parsing can sometimes add an additional null,
 		//        so right now we have to account for that.
 		if (c == '\0') break;
 
-		auto ch = characters.find(c);
-		if (ch == characters.end())
-			ch = LoadMissingGlyph(c);
+		auto ch = GetGlyph(c);
+		if (!ch)
+			continue;
+
+		// Nothing to draw for whitespace
+		if (ch->size.x > 0 && ch->size.y > 0)
+			layout.glyphs.emplace_back(Layout::Glyph{ ch, x });
+
+		x += ch->advance * glyphScale;
 
-		ret.width += std::ceil(ch->second.advance * scale);
+		ret.width += std::ceil(ch->advance * scale);
 
 		// Find max y bearing
-		auto y = std::ceil(ch->second.metrics.horiBearingY * scale);
+		auto y = std::ceil(ch->metrics.horiBearingY * scale);
 
 		if (y > ret.y)
 			ret.y = y;
 
 		// Fid max height, taking bearing into consideration
-		if (auto height = std::ceil(ch->second.metrics.height * scale); height - y > ret.renderedHeight)
+		if (auto height = std::ceil(ch->metrics.height * scale); height - y > ret.renderedHeight)
 			ret.renderedHeight = height - y;
 
 		// Find max overhang below the baseline, for vertical centering
-		if ((ch->second.metrics.height - ch->second.metrics.horiBearingY) * scale > ret.overhang)
-			ret.overhang = (ch->second.metrics.height - ch->second.metrics.horiBearingY) * scale;
+		if ((ch->metrics.height - ch->metrics.horiBearingY) * scale > ret.overhang)
+			ret.overhang = (ch->metrics.height - ch->metrics.horiBearingY) * scale;
 	}
 
 	ret.y += outlineRadius;
 	ret.renderedHeight += ret.y + outlineRadius;
 	ret.width += outlineRadius * 2;
 
-	return ret;
+	return glyphs->layouts.Insert(key, std::move(layout));
 }
 
-std::pair<std::unique_ptr<FramebufferObject>, OpenGLFont::Bounds> OpenGLFont::CacheText(const std::string &text, glm::vec3 color, Context &context) {
-	const auto bounds = MeasureText(text, 1.0f);
+std::pair<std::shared_ptr<OpenGLFont::CachedText>, OpenGLFont::Bounds> OpenGLFont::CacheText(const std::string &text, glm::vec3 color, Context &context) {
+	const auto &layout = GetLayout(text, 1.0f);
+	const auto bounds = layout.bounds;
+
+	auto cached = std::make_shared<CachedText>(CachedText{ text, color, bounds, {}, layout.glyphs.size() });
+
+	RenderToAtlas(*cached, context);
+
+	return std::make_pair(std::move(cached), bounds);
+}
+
+bool OpenGLFont::RenderToAtlas(CachedText &cached, Context &context) {
+	const auto &bounds = cached.bounds;
+
+	if (!textAtlas)
+		textAtlas = std::make_shared<TextAtlas>();
 
-	auto framebuffer = std::make_unique<FramebufferObject>(bounds.width, bounds.renderedHeight);
-	framebuffer->Bind();
-	GLint oldViewport[4];
+	auto entry = textAtlas->Allocate(bounds.width, bounds.renderedHeight);
+	if (!entry)
+		return false;
+
+	cached.entry = *entry;
+
+	textAtlas->BeginRender(cached.entry);
 
 	// We don't want to apply the alpha channel twice
 	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
-	glGetIntegerv(GL_VIEWPORT, oldViewport);
-	glViewport(0, 0, bounds.width, bounds.renderedHeight);
 	auto projection = glm::ortho(0.0f, static_cast<float>(bounds.width), 0.0f, static_cast<float>(bounds.renderedHeight));
 	projection = glm::translate(
 		projection, 
@@ -303,72 +650,162 @@ std::pair<std::unique_ptr<FramebufferObject>, OpenGLFont::Bounds> OpenGLFont::Ca
 			0.0f
 		)
 	);
-	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-	RenderText(text, projection, color, context);
-	framebuffer->Unbind();
-	glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
+
+	// Don't drag along anything the caller has queued
+	std::vector<Batch> queued;
+	std::swap(queued, batches);
+
+	RenderText(cached.text, projection, cached.color, context);
+
+	std::swap(queued, batches);
+
+	textAtlas->EndRender();
 
 	// Return to our normal blending
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	return std::make_pair(std::move(framebuffer), bounds);
+	return true;
 }
 
-void OpenGLFont::RenderCached(const std::unique_ptr<FramebufferObject> &framebuffer, glm::mat4 projection, Context &context) {
-	context.Translate(-outlineRadius, 0, 0);
-	context.Apply();
+void OpenGLFont::QueueCached(const std::shared_ptr<CachedText> &cached, glm::vec2 position, Context &context) {
+	// Its page got evicted since, so render it again
+	if (!textAtlas || !textAtlas->IsValid(cached->entry)) {
+		if (!RenderToAtlas(*cached, context))
+			return;
+	}
+
+	textAtlas->Queue(cached->entry, position);
 
-	framebuffer->Draw(0, 0, context);
+	statistics.glyphs += cached->glyphs;
+}
+
+void OpenGLFont::FlushCached(const glm::mat4 &projection, Context &context) {
+	if (!textAtlas)
+		return;
+
+	statistics.drawCalls += textAtlas->Flush(projection, context);
+	statistics.bytesUploaded += textAtlas->GetFlushedBytes();
+}
 
-	context.Translate(outlineRadius, 0, 0);
-	context.Apply();
+void OpenGLFont::RenderCached(const std::shared_ptr<CachedText> &cached, glm::mat4 projection, Context &context) {
+	QueueCached(cached, { static_cast<float>(-outlineRadius), 0.0f }, context);
+	FlushCached(context.GetProjection(), context);
 }
 
 void OpenGLFont::RenderText(const std::string &text, glm::mat4 projection, glm::vec3 color, Context &context) {
-	context.Use("font"_hash);
+	QueueText(text, { 0.0f, 0.0f }, color);
+	FlushText(projection, context);
+}
 
-	if (color != lastColor) {
-		context.Color(color.x, color.y, color.z, 1.0f);
-		lastColor = color;
-	}
+void OpenGLFont::QueueText(const std::string &text, glm::vec2 position, glm::vec3 color) {
+	for (const auto &glyph : GetLayout(text, 1.0f).glyphs)
+		QueueGlyph(*glyph.character, { position.x + glyph.x, position.y }, color);
+}
+
+float OpenGLFont::QueueGlyph(FT_ULong c, glm::vec2 pen, glm::vec3 color) {
+	auto ch = GetGlyph(c);
+	if (!ch)
+		return 0.0f;
+
+	// Nothing to draw for whitespace
+	if (ch->size.x > 0 && ch->size.y > 0)
+		QueueGlyph(*ch, pen, color);
+
+	return ch->advance * GetGlyphScale();
+}
+
+void OpenGLFont::QueueGlyph(const Character &character, glm::vec2 pen, const glm::vec3 &color) {
+	const auto scale = GetGlyphScale();
+
+	// LCD bitmaps hold three subpixels per pixel
+	const auto subpixels = renderMode == RenderMode::Lcd ? 3 : 1;
+
+	const auto &uv = character.uv;
+
+	const auto left = pen.x + character.bearing.x * scale;
+	const auto top = pen.y - character.bearing.y * scale;
+	const auto right = left + (character.size.x / subpixels) * scale;
+	const auto bottom = top + character.size.y * scale;
+
+	++statistics.glyphs;
+
+	const auto r = color.x;
+	const auto g = color.y;
+	const auto b = color.z;
+
+	auto &vertices = GetBatch(character.page).vertices;
+	vertices.insert(vertices.end(), {
+		left,  top,    uv.x, uv.y, r, g, b,
+		left,  bottom, uv.x, uv.w, r, g, b,
+		right, bottom, uv.z, uv.w, r, g, b,
+
+		left,  top,    uv.x, uv.y, r, g, b,
+		right, bottom, uv.z, uv.w, r, g, b,
+		right, top,    uv.z, uv.y, r, g, b
+	});
+}
+
+void OpenGLFont::FlushText(const glm::mat4 &projection, Context &context) {
+	// Drop batches that weren't used since the last flush
+	batches.erase(
+		std::remove_if(batches.begin(), batches.end(), [](const Batch &batch) { return batch.vertices.empty(); }),
+		batches.end()
+	);
+
+	// Everything goes up in a single upload...
+	stream.clear();
+	for (const auto &batch : batches)
+		stream.insert(stream.end(), batch.vertices.begin(), batch.vertices.end());
+
+	if (stream.empty())
+		return;
+
+	context.Use(renderMode == RenderMode::Sdf ? "font_sdf"_hash : "font"_hash);
+	context.GetShaderProgram().UniformMatrix4fv(
+		"projection",
+		1,
+		GL_FALSE,
+		projection
+	);
+
+	// Plain and outlined fonts share the program
+	if (renderMode == RenderMode::Sdf)
+		glUniform1f(context.GetShaderProgram().GetUniformLocation<true>("outline"), GetSdfOutline());
 
 	vao.Bind();
+	vbo.Bind();
+	vbo.Stream(stream);
 
-	const auto converted = converter.from_bytes(text);
+	statistics.bytesUploaded += stream.size() * sizeof(float);
 
-	// iterate through all characters
-	for (const auto &c : converted) {
-		if (c == '\0') break;
+	// ...and is drawn with one call per atlas page, colors
+	// being part of the vertices
+	GLint first = 0;
+	for (auto &batch : batches) {
+		const auto count = static_cast<GLsizei>(batch.vertices.size() / VertexSize);
 
-		context.GetShaderProgram().UniformMatrix4fv(
-			"projection",
-			1,
-			GL_FALSE,
-			projection
-		);
+		atlas.GetPage(batch.page).Bind();
+		vbo.DrawArrays(GL_TRIANGLES, first, count);
+		++statistics.drawCalls;
 
-		auto &ch = characters.find(c);
-		if (ch == characters.end())
-			ch = LoadMissingGlyph(c);
-
-		// render glyph texture over quad
-		ch->second.texture.Bind();
-		// render quad
-		vbo.DrawArrays(GL_TRIANGLES, 6 * ch->second.index, 6);
-
-		// now advance cursors for next glyph
-		projection = glm::translate(
-			projection,
-			glm::vec3(
-				ch->second.advance,
-				0,
-				0
-			)
-		);
+		first += count;
+
+		// Keep the allocation around for the next frame
+		batch.vertices.clear();
 	}
+
+	vbo.Unbind();
 	vao.Unbind();
 
 	context.Use("texture"_hash);
 }
+
+OpenGLFont::Batch &OpenGLFont::GetBatch(std::size_t page) {
+	for (auto &batch : batches) {
+		if (batch.page == page)
+			return batch;
+	}
+
+	return batches.emplace_back(Batch{ page, {} });
+}
 }
\ No newline at end of file
@@ -1,10 +1,11 @@
 #pragma once
 
-#include <codecvt>
+#include <array>
+#include <filesystem>
 #include <map>
 #include <optional>
-#include <locale>
 #include <memory>
+#include <unordered_map>
 
 #include <freetype/ftstroke.h>
 
@@ -18,9 +19,15 @@
 
 #include "Buffer.hpp"
 #include "Context.hpp"
+#include "CoverageIndex.hpp"
+#include "Fnv1a.hpp"
 #include "Framebuffer.hpp"
+#include "GlyphAtlas.hpp"
+#include "GlyphCache.hpp"
 #include "Logger.hpp"
+#include "LruCache.hpp"
 #include "ShaderProgram.hpp"
+#include "TextAtlas.hpp"
 #include "Texture.hpp"
 #include "VertexArray.hpp"
 
@@ -44,12 +51,34 @@ public:
 		int x = 0, y = 0, width = 0, height = 0, renderedHeight = 0, overhang = 0;
 	};
 
-	bool OnInit(const std::vector<std::string> &fonts, FT_UInt size, int outline = 0);
-	bool OnInit(const std::string &rootFont, FT_UInt size, int outline = 0);
+	enum class RenderMode {
+		Lcd,	// Subpixel bitmaps, rasterized for each size
+		Sdf		// Signed distance fields, rasterized once at SdfReferenceSize
+	};
+
+	// Glyphs are streamed with their position (attribute 0), texture
+	// coordinates (attribute 1) and color (attribute 2, a vec3), so that
+	// text of any color is drawn with one call per atlas page; the "font"
+	// shader has to take the color from there (see benchmarks/shaders/).
+	//
+	// Distance fields are rendered at this pixel size and scaled to the
+	// requested one; they need the "font_sdf" shader (see shaders/)
+	static constexpr FT_UInt SdfReferenceSize = 64;
+	static constexpr FT_Int SdfSpread = 8;
+
+	bool OnInit(const std::vector<std::string> &fonts, FT_UInt size, int outline = 0, RenderMode mode = RenderMode::Lcd);
+	bool OnInit(const std::string &rootFont, FT_UInt size, int outline = 0, RenderMode mode = RenderMode::Lcd);
 
 	const bool HasFaces() const { return !faces.empty(); }
+
+	// Whether any face in the fallback chain has a glyph for c
+	const bool HasGlyph(FT_ULong c) const { return coverage.Find(c).has_value(); }
 	
 	bool SetFontSize(FT_UInt size);
+
+	// In SDF mode the outline comes from the distance field instead of
+	// a stroker, so it follows size changes without re-rasterizing. It
+	// can't reach past the spread, SdfSpread * size / SdfReferenceSize.
 	void SetOutlineRadius(int radius);
 
 	const int GetOutlineRadius() const { return outlineRadius; }
@@ -57,10 +86,23 @@ public:
 	void OnDestroy();
 
 	Bounds MeasureText(const std::string &text, float scale = 1.0f);
-	FT_Short GetAscender() const { return std::abs(faces.at(0)->ascender >> 6); }
-	FT_Short GetDescender() const { return std::abs(faces.at(0)->size->metrics.descender >> 6); }
+	FT_Short GetAscender() const { return static_cast<FT_Short>(std::abs(faces.at(0)->ascender >> 6) * GetGlyphScale()); }
+	FT_Short GetDescender() const { return static_cast<FT_Short>(std::abs(faces.at(0)->size->metrics.descender >> 6) * GetGlyphScale()); }
+
+	const RenderMode GetRenderMode() const { return renderMode; }
+
+	// Pre-rendered string, living in a region of a TextAtlas page
+	struct CachedText {
+		std::string text;
+		glm::vec3 color;
+		Bounds bounds;
+		TextAtlas::Entry entry;
+
+		// What drawing it replaces, for the statistics
+		std::size_t glyphs = 0;
+	};
 
-	std::pair<std::unique_ptr<FramebufferObject>, Bounds> CacheText(const std::string &text, glm::vec3 color, Context &context);
+	std::pair<std::shared_ptr<CachedText>, Bounds> CacheText(const std::string &text, glm::vec3 color, Context &context);
 	void RenderText(
 		const std::string &text,
 		glm::mat4 projection, // passed by VALUE
@@ -68,17 +110,80 @@ public:
 		Context &context
 	);
 
-	void RenderCached(const std::unique_ptr<FramebufferObject> &framebuffer, glm::mat4 projection, Context &context);
+	// Lays text out into the current batch, relative to position
+	// (the baseline origin). Nothing is drawn until FlushText().
+	void QueueText(const std::string &text, glm::vec2 position, glm::vec3 color);
+
+	// Queues a single glyph with its pen position on the baseline, for
+	// callers doing their own layout (see Paragraph). Returns the advance.
+	float QueueGlyph(FT_ULong c, glm::vec2 pen, glm::vec3 color);
+
+	// Scaled horizontal advance, loading the glyph if needed
+	float GetAdvance(FT_ULong c) {
+		auto ch = GetGlyph(c);
+		return ch ? ch->advance * GetGlyphScale() : 0.0f;
+	}
+
+	// Baseline to baseline distance and the height above
+	// the baseline, at the current size
+	float GetLineHeight() const { return (faces.at(0)->size->metrics.height >> 6) * GetGlyphScale(); }
+	float GetLineAscender() const { return (faces.at(0)->size->metrics.ascender >> 6) * GetGlyphScale(); }
+
+	// Uploads everything queued since the last flush into one stream
+	// and draws it with a single call per atlas page
+	void FlushText(const glm::mat4 &projection, Context &context);
+
+	void RenderCached(const std::shared_ptr<CachedText> &cached, glm::mat4 projection, Context &context);
+
+	// Same as QueueText() / FlushText(), but for cached text. Strings
+	// whose atlas page has been evicted are rendered again on demand.
+	void QueueCached(const std::shared_ptr<CachedText> &cached, glm::vec2 position, Context &context);
+	void FlushCached(const glm::mat4 &projection, Context &context);
+
+	// Fonts can share one atlas for their cached text
+	void SetTextAtlas(std::shared_ptr<TextAtlas> textAtlas) { this->textAtlas = std::move(textAtlas); }
+	const std::shared_ptr<TextAtlas> &GetTextAtlas() const { return textAtlas; }
 
-	const OpenGLFont::Bounds &GetEm() const { return em; }
+	// Glyphs get loaded from (and saved to) this directory, keyed by the
+	// font data, size, outline and render mode. Call before OnInit().
+	void SetGlyphCache(const std::filesystem::path &directory) { glyphCache = std::make_unique<GlyphCache>(directory); }
+
+	// Saves every glyph of the current size, including the ones loaded
+	// on demand (the initial set is saved when it gets rasterized)
+	void SaveGlyphCache();
+
+	const OpenGLFont::Bounds &GetEm() const { return glyphs->em; }
+
+	// Counted from construction or the last ResetStatistics()
+	struct Statistics {
+		std::size_t drawCalls = 0;
+		std::size_t glyphs = 0;			// Quads queued, counting the glyphs of cached strings
+		std::size_t bytesUploaded = 0;	// Vertex streams and glyph bitmaps
+	};
+
+	Statistics GetStatistics() const {
+		auto ret = statistics;
+		ret.bytesUploaded += atlas.GetBytesUploaded() - atlasBytesUploaded;
+		return ret;
+	}
+
+	void ResetStatistics() {
+		statistics = Statistics();
+		atlasBytesUploaded = atlas.GetBytesUploaded();
+	}
+
+	// MeasureText() and QueueText() share a cache of laid out
+	// strings (one per size), flushed along with the glyphs
+	void SetLayoutCacheCapacity(std::size_t capacity);
+	const auto &GetLayoutCacheStatistics() const { return glyphs->layouts.GetStatistics(); }
 
 private:
 	struct Character {
 		Character() = delete;
 		Character(Character &&) = default;
-		Character(GLint index, Texture2D &&texture, glm::ivec2 &&size, glm::ivec2 &&bearing, FT_Glyph_Metrics &metrics, FT_Pos &&advance) :
-			index(index),
-			texture(std::move(texture)),
+		Character(std::size_t page, glm::vec4 &&uv, glm::ivec2 &&size, glm::ivec2 &&bearing, const FT_Glyph_Metrics &metrics, FT_Pos &&advance) :
+			page(page),
+			uv(std::move(uv)),
 			size(std::move(size)),
 			bearing(std::move(bearing)),
 			metrics(metrics),
@@ -87,41 +192,172 @@ private:
 			this->metrics.horiBearingY >>= 6;
 		}
 
-		GLint index;
-		Texture2D texture;	// ID handle of the glyph texture
+		std::size_t page;	// Atlas page holding the glyph bitmap
+		glm::vec4 uv;		// Atlas texture coordinates (left, top, right, bottom)
 		glm::ivec2 size;	// Size of glyph
 		glm::ivec2 bearing;	// Offset from baseline to left/top of glyph
 		FT_Glyph_Metrics metrics;
 		FT_Pos advance;		// Offset to advance to next glyph
 	};
 
+	// Also what the glyph cache stores
+	using RasterizedGlyph = GlyphCache::Glyph;
+
+	// FreeType state for rasterizing off the GL thread, opened
+	// from the same font data and settings as the given font
+	struct Rasterizer {
+		explicit Rasterizer(const OpenGLFont &font);
+		~Rasterizer();
+
+		FT_Library ft = nullptr;
+		std::vector<FT_Face> faces;
+		FT_Stroker stroker = nullptr;
+		RenderMode renderMode = RenderMode::Lcd;
+
+		bool valid = false;
+	};
+
+	// Doesn't touch GL or any glyph tables, so it can run on any thread
+	// (as long as nothing else uses the same faces and stroker)
+	static std::optional<RasterizedGlyph> Rasterize(
+		const FT_ULong c,
+		const std::vector<FT_Face> &faces,
+		const CoverageIndex &coverage,
+		FT_Stroker stroker,
+		RenderMode renderMode
+	);
+
+	// Uploads the bitmap and adds the glyph to the current size
+	const Character *CommitGlyph(const RasterizedGlyph &glyph);
+
+	// Commits everything the glyph cache has for the current size
+	bool LoadCachedGlyphs();
+	std::uint64_t GetGlyphCacheKey() const;
+
+	bool LoadFaces();
 	inline bool LoadInitialCharacters();
-	inline std::map<FT_ULong, Character>::iterator LoadGlyph(std::size_t i, const FT_ULong c);
-	std::map<FT_ULong, Character>::iterator LoadMissingGlyph(const FT_ULong c);
+	inline const Character *LoadGlyph(const FT_ULong c);
+	const Character *LoadMissingGlyph(const FT_ULong c);
+
+	void QueueGlyph(const Character &character, glm::vec2 pen, const glm::vec3 &color);
+
+	// Loads the glyph if we haven't seen it yet
+	inline const Character *GetGlyph(const FT_ULong c) {
+		if (c < glyphs->latin.size()) {
+			if (auto ch = glyphs->latin[c])
+				return ch;
+		} else if (auto iter = glyphs->characters.find(c); iter != glyphs->characters.end()) {
+			return &iter->second;
+		}
+
+		return LoadMissingGlyph(c);
+	}
+
+	void ClearGlyphs();
+
+	void SetLibraryProperties(FT_Library library) const;
+	void SetStrokerProperties(FT_Stroker stroker) const;
+
+	inline FT_UInt GetPixelSize() const {
+		return renderMode == RenderMode::Sdf ? SdfReferenceSize : fontSize;
+	}
+
+	// Size of the rendered glyphs relative to the stored ones
+	inline float GetGlyphScale() const {
+		return renderMode == RenderMode::Sdf ? static_cast<float>(fontSize) / SdfReferenceSize : 1.0f;
+	}
+
+	// How far font_sdf.frag moves the edge out for the outline
+	float GetSdfOutline() const;
+
+	struct Layout {
+		struct Glyph {
+			const Character *character;
+			float x;	// Pen position, relative to the origin
+		};
+
+		std::string text;
+		Bounds bounds;
+		std::vector<Glyph> glyphs;	// Only those with a bitmap
+	};
+
+	bool RenderToAtlas(CachedText &cached, Context &context);
+
+	// Keyed by the string, scale, size and outline
+	const Layout &GetLayout(const std::string &text, float scale);
 
 	std::vector<std::string> fonts;
 
 	FT_Library ft;
 	std::vector<FT_Face> faces;
 
+	// Which face to take each code point from
+	CoverageIndex coverage;
+
+	// Font files are read once and parsed by FreeType
+	// in place, so they have to outlive the faces
+	std::vector<std::vector<FT_Byte>> fontData;
+	std::uint64_t fontHash = Fnv1a::Basis;
+
+	std::unique_ptr<GlyphCache> glyphCache;
+
+	// Floats per streamed vertex: x, y, u, v, r, g, b
+	static constexpr std::size_t VertexSize = 7;
+
+	// Queued glyph quads sharing a page, whatever their colors
+	struct Batch {
+		std::size_t page;
+		std::vector<float> vertices;
+	};
+
+	Batch &GetBatch(std::size_t page);
+
 	VertexArray vao;
 	ArrayBuffer vbo;
-	std::map<FT_ULong, Character> characters;
+	std::vector<Batch> batches;
+	std::vector<float> stream;
+
+	// Everything rasterized at one pixel size
+	struct GlyphSet {
+		// One per face, created with FT_New_Size()
+		std::vector<FT_Size> sizes;
+
+		// Nodes are stable, so latin can point into this
+		std::unordered_map<FT_ULong, Character> characters;
+
+		// Direct lookup for Basic Latin / Latin-1,
+		// which covers most of what we render
+		std::array<const Character *, 256> latin{};
+
+		LruCache<uint64_t, Layout> layouts;
+
+		int overhang = 0;
 
-	// Needs to be static since multiple instances
-	// of OpenGLFont could update the shader uniform
-	static glm::vec3 lastColor;
+		Bounds em{ 0, 0, 0, 0 };
+	};
+
+	// Keyed by pixel size, so going back to a size we've
+	// used before doesn't have to rasterize anything
+	std::map<FT_UInt, GlyphSet> glyphSets;
+	GlyphSet *glyphs = nullptr;
+
+	// Shared by all sizes
+	GlyphAtlas atlas;
+
+	std::size_t layoutCacheCapacity = 1024;
+
+	Statistics statistics;
+	std::size_t atlasBytesUploaded = 0;
 
 	std::unique_ptr<FramebufferObject> framebuffer;
 
-	std::wstring_convert<std::codecvt_utf8<uint32_t>, uint32_t> converter;
+	std::shared_ptr<TextAtlas> textAtlas;
 
 	FT_Stroker stroker = nullptr;
 
-	int outlineRadius = 0;
-
-	int overhang = 0;
+	RenderMode renderMode = RenderMode::Lcd;
 
-	Bounds em{ 0, 0, 0, 0 };
+	FT_UInt fontSize = 0;
+	int outlineRadius = 0;
 };
 }
\ No newline at end of file
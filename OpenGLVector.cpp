@@ -1,14 +1,25 @@
 #include "OpenGLVector.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <optional>
+#include <tuple>
+
+#include <glm/glm.hpp>
+
+#include "ScopedAlphaBlend.hpp"
+
 namespace Fetcko {
 OpenGLVector::~OpenGLVector() {
 }
 
-bool OpenGLVector::Load(const std::filesystem::path &path, float size) {
-	return Load(path, { size, -1.0f });
+bool OpenGLVector::Load(const std::filesystem::path &path, float size, float feather) {
+	return Load(path, { size, -1.0f }, feather);
 }
 
-bool OpenGLVector::Load(const std::filesystem::path &path, Size<float> size) {
+bool OpenGLVector::Load(const std::filesystem::path &path, Size<float> size, float feather) {
 	auto string = Utils::GetStringFromFile(path);
 
 	if (string.empty()) return false;
@@ -127,11 +138,20 @@ bool OpenGLVector::Load(const std::filesystem::path &path, Size<float> size) {
 
 	this->size = size;
 
+	// Everything is well inside the outline until a fringe says otherwise
+	distances.assign(vertices.size() / 2, 1.0f);
+
+	if (feather > 0.0f)
+		AddFringe(feather);
+
 	vao.Bind();
 	vbo.Bind();
 	vbo.BufferData(vertices);
 	vao.AddAttribute(VertexArray::Attribute(0, 2));
-	vbo.Unbind();
+	distanceBuffer.Bind();
+	distanceBuffer.BufferData(distances);
+	vao.AddAttribute(VertexArray::Attribute(1, 1));
+	distanceBuffer.Unbind();
 	vao.Unbind();
 
 	indexBuffer.Bind();
@@ -140,8 +160,135 @@ bool OpenGLVector::Load(const std::filesystem::path &path, Size<float> size) {
 	return true;
 }
 
+void OpenGLVector::AddFringe(float feather) {
+	struct Edge {
+		unsigned short a;
+		unsigned short b;
+		unsigned short opposite;
+		int count = 0;
+	};
+
+	// Exports can leave duplicate vertices along seams between faces,
+	// which would make those look like boundary edges. Whichever index
+	// comes first stands in for every vertex at the same position.
+	std::map<std::pair<float, float>, unsigned short> firstAt;
+	std::vector<unsigned short> welded(vertices.size() / 2);
+
+	for (std::size_t i = 0; i < welded.size(); ++i)
+		welded[i] = firstAt.try_emplace({ vertices[i * 2], vertices[i * 2 + 1] }, static_cast<unsigned short>(i)).first->second;
+
+	std::map<std::pair<unsigned short, unsigned short>, Edge> edges;
+
+	for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+		for (int j = 0; j < 3; ++j) {
+			const auto a = welded[indices[i + j]];
+			const auto b = welded[indices[i + (j + 1) % 3]];
+
+			auto &edge = edges[std::minmax(a, b)];
+			edge.a = a;
+			edge.b = b;
+			edge.opposite = welded[indices[i + (j + 2) % 3]];
+			++edge.count;
+		}
+	}
+
+	const auto position = [this](unsigned short index) {
+		return glm::vec2(vertices[index * 2], vertices[index * 2 + 1]);
+	};
+
+	struct Outline {
+		glm::vec2 normal{ 0.0f };	// Sum of the outward normals of its edges
+		glm::vec2 first{ 0.0f };	// Normal of the first edge seen
+		glm::vec2 inner{ 0.0f };
+		unsigned short outer = 0;
+	};
+
+	std::map<unsigned short, Outline> outline;
+	std::vector<std::tuple<unsigned short, unsigned short>> boundary;
+
+	for (const auto &[key, edge] : edges) {
+		if (edge.count != 1)
+			continue;
+
+		const auto a = position(edge.a);
+		const auto direction = position(edge.b) - a;
+		const auto length = glm::length(direction);
+
+		if (length <= 0.0f)
+			continue;
+
+		auto normal = glm::vec2(-direction.y, direction.x) / length;
+
+		// Point away from the rest of the triangle
+		if (glm::dot(normal, position(edge.opposite) - a) > 0.0f)
+			normal = -normal;
+
+		for (const auto index : { edge.a, edge.b }) {
+			auto &point = outline[index];
+
+			if (point.normal == glm::vec2(0.0f))
+				point.first = normal;
+
+			point.normal += normal;
+		}
+
+		boundary.emplace_back(edge.a, edge.b);
+	}
+
+	if (vertices.size() / 2 + outline.size() > std::numeric_limits<unsigned short>::max()) {
+		logger.LogWarning("Too many vertices to add a fringe, the edges won't be antialiased");
+		return;
+	}
+
+	// The band straddles the outline: each outline vertex moves in along
+	// the average of its edges' normals, and gets an outer vertex as far
+	// out, so that the outline runs down the middle of a feather wide band
+	for (auto &[index, point] : outline) {
+		auto normal = point.first;
+
+		if (const auto length = glm::length(point.normal); length > 1e-4f)
+			normal = point.normal / length;
+
+		// Limit how far sharp corners can reach
+		const auto scale = 1.0f / std::max(glm::dot(normal, point.first), 0.25f);
+		const auto offset = normal * (feather / 2.0f) * scale;
+		const auto outer = position(index) + offset;
+
+		point.inner = position(index) - offset;
+		point.outer = static_cast<unsigned short>(vertices.size() / 2);
+
+		vertices.emplace_back(outer.x);
+		vertices.emplace_back(outer.y);
+		distances.emplace_back(-1.0f);
+	}
+
+	// Duplicates (see above) move along with the vertex standing in for them
+	for (std::size_t i = 0; i < welded.size(); ++i) {
+		if (auto point = outline.find(welded[i]); point != outline.end()) {
+			vertices[i * 2] = point->second.inner.x;
+			vertices[i * 2 + 1] = point->second.inner.y;
+		}
+	}
+
+	for (const auto &[a, b] : boundary) {
+		const auto outerA = outline[a].outer;
+		const auto outerB = outline[b].outer;
+
+		indices.insert(indices.end(), { a, b, outerB, a, outerB, outerA });
+	}
+
+	this->feather = feather;
+}
+
 void OpenGLVector::Render() {
-	glDisable(GL_BLEND);
+	// The edges fade out through their alpha, and the
+	// caller's blending is put back once it's drawn
+	std::optional<ScopedAlphaBlend> blend;
+	if (feather > 0.0f)
+		blend.emplace();
+	else
+		glDisable(GL_BLEND);
+
 	vao.Bind();
 	indexBuffer.Bind();
 	indexBuffer.DrawElements(GL_TRIANGLES);
@@ -38,20 +38,34 @@ class OpenGLVector : public LoggableClass {
 public:
 	~OpenGLVector();
 
-	bool Load(const std::filesystem::path &path, float size);
-	bool Load(const std::filesystem::path &path, Size<float> size);
+	// With a feather, the outline runs down the middle of a band that
+	// wide (in the same units as size), for shaders/vector_aa to
+	// antialias with instead of needing a multisampled framebuffer.
+	// Every vertex carries its signed distance from the outline
+	// (attribute 1), in halves of the band: 1 for the inner side of
+	// the band and everything inside it, -1 for the outer side. The
+	// fade itself is a screen pixel wide, whatever the feather, so a
+	// feather of a couple of pixels at the size drawn is plenty.
+	bool Load(const std::filesystem::path &path, float size, float feather = 0.0f);
+	bool Load(const std::filesystem::path &path, Size<float> size, float feather = 0.0f);
 
 	void Render();
 
 	const Size<float> &GetSize() const { return size; }
 
 private:
+	// Adds quads along the edges only used by a single triangle
+	void AddFringe(float feather);
+
 	std::vector<float> vertices;
+	std::vector<float> distances;
 	std::vector<unsigned short> indices;
 	Size<float> size;
+	float feather = 0.0f;
 
 	VertexArray vao;
 	ArrayBuffer vbo;
+	ArrayBuffer distanceBuffer;
 	ElementBuffer indexBuffer;
 };
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "Paragraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "Utf8.hpp"
+
+namespace Fetcko {
+Paragraph::Paragraph(OpenGLFont &font, float width, Alignment alignment) :
+	font(font),
+	width(width),
+	alignment(alignment) {
+	Relayout();
+}
+
+void Paragraph::SetText(const std::string &text) {
+	this->text = text;
+	Relayout();
+}
+
+void Paragraph::Replace(std::size_t offset, std::size_t count, const std::string &text) {
+	offset = std::min(offset, this->text.size());
+	count = std::min(count, this->text.size() - offset);
+
+	this->text.replace(offset, count, text);
+
+	Reflow(
+		offset,
+		offset + count,
+		static_cast<std::ptrdiff_t>(text.size()) - static_cast<std::ptrdiff_t>(count)
+	);
+}
+
+void Paragraph::SetWidth(float width) {
+	if (this->width == width)
+		return;
+
+	this->width = width;
+	Relayout();
+}
+
+void Paragraph::Relayout() {
+	lines.clear();
+	Reflow(0, 0, 0);
+}
+
+void Paragraph::Queue(glm::vec2 position, glm::vec3 color, std::size_t first, std::size_t count) {
+	if (first >= lines.size())
+		return;
+
+	const auto last = count < lines.size() - first ? first + count : lines.size();
+
+	const auto lineHeight = font.GetLineHeight();
+	const auto ascender = font.GetLineAscender();
+
+	const auto factor = alignment == Alignment::Center ? 0.5f : alignment == Alignment::Right ? 1.0f : 0.0f;
+	const auto boxWidth = width > 0.0f || factor == 0.0f ? width : GetContentWidth();
+
+	for (auto i = first; i < last; ++i) {
+		const auto &line = lines[i];
+
+		const glm::vec2 pen{
+			position.x + std::round((boxWidth - line.width) * factor),
+			position.y + ascender + (i - first) * lineHeight
+		};
+
+		for (const auto &glyph : line.glyphs)
+			font.QueueGlyph(glyph.c, { pen.x + glyph.x, pen.y }, color);
+	}
+}
+
+float Paragraph::GetContentWidth() const {
+	float ret = 0.0f;
+
+	for (const auto &line : lines)
+		ret = std::max(ret, line.width);
+
+	return ret;
+}
+
+Paragraph::Line Paragraph::LayoutLine(std::size_t begin) {
+	Line ret;
+	ret.begin = begin;
+	ret.end = text.size();
+
+	const std::string_view rest(text.data() + begin, text.size() - begin);
+
+	float x = 0.0f;
+
+	// Where we can wrap: the first space after a word, and
+	// the end of that run of spaces (where the next line begins)
+	auto breakEnd = std::string::npos;
+	auto breakWidth = 0.0f;
+	std::size_t breakGlyphs = 0;
+	auto afterSpace = false;
+
+	const Utf8 decoder(rest);
+	for (auto iter = decoder.begin(); iter != decoder.end(); ++iter) {
+		const auto c = *iter;
+		const auto offset = begin + static_cast<std::size_t>(iter.GetPointer() - rest.data());
+
+		if (c == '\n') {
+			ret.end = offset + 1;
+			return ret;
+		}
+
+		if (c == ' ' || c == '\t') {
+			if (!afterSpace) {
+				breakWidth = ret.width;
+				breakGlyphs = ret.glyphs.size();
+			}
+
+			afterSpace = true;
+			x += font.GetAdvance(c);
+			continue;
+		}
+
+		if (afterSpace && !ret.glyphs.empty())
+			breakEnd = offset;
+
+		afterSpace = false;
+
+		const auto advance = font.GetAdvance(c);
+
+		if (width > 0.0f && x + advance > width && !ret.glyphs.empty()) {
+			// Wrap after the last word that fit...
+			if (breakEnd != std::string::npos) {
+				ret.end = breakEnd;
+				ret.width = breakWidth;
+				ret.glyphs.resize(breakGlyphs);
+				return ret;
+			}
+
+			// ...or in the middle of one that never will
+			ret.end = offset;
+			return ret;
+		}
+
+		ret.glyphs.emplace_back(Glyph{ c, x });
+		x += advance;
+		ret.width = x;
+	}
+
+	return ret;
+}
+
+void Paragraph::Reflow(std::size_t editBegin, std::size_t editEnd, std::ptrdiff_t delta) {
+	// The line before the edit might be able to take words from it
+	auto first = static_cast<std::size_t>(std::upper_bound(
+		lines.begin(),
+		lines.end(),
+		editBegin,
+		[](std::size_t offset, const Line &line) { return offset < line.begin; }
+	) - lines.begin());
+
+	first = first > 1 ? first - 2 : 0;
+
+	std::vector<Line> previous(
+		std::make_move_iterator(lines.begin() + std::min(first, lines.size())),
+		std::make_move_iterator(lines.end())
+	);
+	lines.resize(std::min(first, lines.size()));
+
+	auto begin = lines.empty() ? 0 : lines.back().end;
+	auto reuse = previous.begin();
+
+	while (begin < text.size()) {
+		lines.emplace_back(LayoutLine(begin));
+		begin = lines.back().end;
+
+		// Lines are laid out the same way whenever they start at the
+		// same spot, so once we're back in sync we can keep the rest
+		while (reuse != previous.end() && (reuse->begin < editEnd || reuse->begin + delta < begin))
+			++reuse;
+
+		if (reuse != previous.end() && reuse->begin + delta == begin && begin < text.size()) {
+			for (; reuse != previous.end(); ++reuse) {
+				reuse->begin += delta;
+				reuse->end += delta;
+				lines.emplace_back(std::move(*reuse));
+			}
+
+			return;
+		}
+	}
+
+	// Empty text, or text ending in a line break, still has a last line
+	if (text.empty() || text.back() == '\n')
+		lines.emplace_back(Line{ text.size(), text.size() });
+}
+}
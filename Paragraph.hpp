@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "OpenGLFont.hpp"
+
+namespace Fetcko {
+// Multi-line text laid out with an OpenGLFont, wrapped at spaces (or
+// anywhere, for words wider than a line) to fit a maximum width.
+//
+// Edits only reflow from the line before the edit up to the first
+// line that starts at the same spot as it did before; everything
+// after that is reused as is. Lines are queued into the font's
+// batches, so a whole paragraph is drawn with FlushText().
+//
+// Offsets are in bytes and have to fall on UTF-8 boundaries.
+class Paragraph {
+public:
+	enum class Alignment {
+		Left,
+		Center,
+		Right
+	};
+
+	struct Glyph {
+		char32_t c;
+		float x;	// Pen position, relative to the start of the line
+	};
+
+	struct Line {
+		std::size_t begin = 0;
+		std::size_t end = 0;	// Where the next line begins
+		float width = 0.0f;		// Without trailing whitespace
+		std::vector<Glyph> glyphs;	// Excluding whitespace
+	};
+
+	// A width of 0 never wraps (other than at '\n')
+	explicit Paragraph(OpenGLFont &font, float width = 0.0f, Alignment alignment = Alignment::Left);
+
+	void SetText(const std::string &text);
+	void Append(const std::string &text) { Replace(this->text.size(), 0, text); }
+	void Insert(std::size_t offset, const std::string &text) { Replace(offset, 0, text); }
+	void Erase(std::size_t offset, std::size_t count) { Replace(offset, count, {}); }
+	void Replace(std::size_t offset, std::size_t count, const std::string &text);
+
+	void SetWidth(float width);
+
+	// Applied when queueing, so this doesn't reflow anything
+	void SetAlignment(Alignment alignment) { this->alignment = alignment; }
+
+	// Lays everything out again, e.g. after changing the font size
+	void Relayout();
+
+	// Queues lines [first, first + count) with the top left corner of
+	// the first one at position; flush with OpenGLFont::FlushText()
+	void Queue(
+		glm::vec2 position,
+		glm::vec3 color,
+		std::size_t first = 0,
+		std::size_t count = std::string::npos
+	);
+
+	const std::string &GetText() const { return text; }
+	const std::vector<Line> &GetLines() const { return lines; }
+
+	const float GetLineHeight() const { return font.GetLineHeight(); }
+	const float GetHeight() const { return lines.size() * font.GetLineHeight(); }
+
+	// Widest line, which alignment is relative to when not wrapping
+	float GetContentWidth() const;
+
+private:
+	Line LayoutLine(std::size_t begin);
+
+	// Lays out lines again from the one before editBegin onwards. editEnd
+	// is in the old text; delta is how much the text after it moved.
+	void Reflow(std::size_t editBegin, std::size_t editEnd, std::ptrdiff_t delta);
+
+	OpenGLFont &font;
+
+	std::string text;
+	std::vector<Line> lines;
+
+	float width = 0.0f;
+	Alignment alignment = Alignment::Left;
+};
+}
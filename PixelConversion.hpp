@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// The SSSE3 kernel gets compiled for any x86 build and picked at
+// runtime, so it doesn't depend on the flags the library is built with
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <tmmintrin.h>
+#define FETCKO_PIXEL_CONVERSION_SSSE3 1
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FETCKO_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define FETCKO_TARGET_SSSE3
+#endif
+#else
+#define FETCKO_PIXEL_CONVERSION_SSSE3 0
+#endif
+
+namespace Fetcko {
+// Turns RGBA readbacks into 24-bit pixels (as BMP wants them) in a
+// single pass: the channel swizzle, the row padding and the vertical
+// flip all happen while writing into the destination.
+class PixelConversion {
+public:
+	enum class Order {
+		Rgb,
+		Bgr
+	};
+
+	// Rows of 24-bit pixels are padded to 4 bytes
+	static constexpr std::size_t GetPitch(std::size_t width) {
+		return (width * 3 + 3) & ~static_cast<std::size_t>(3);
+	}
+
+	// Converts one row of width RGBA pixels, leaving the padding alone
+	static void ConvertRow(const uint8_t *rgba, std::size_t width, Order order, uint8_t *destination) {
+		std::size_t x = 0;
+
+#if FETCKO_PIXEL_CONVERSION_SSSE3
+		if (HasSsse3())
+			x = ConvertRowSsse3(rgba, width, order, destination);
+#endif
+
+		const auto red = order == Order::Rgb ? 0 : 2;
+		const auto blue = 2 - red;
+
+		for (; x < width; ++x) {
+			destination[x * 3] = rgba[x * 4 + red];
+			destination[x * 3 + 1] = rgba[x * 4 + 1];
+			destination[x * 3 + 2] = rgba[x * 4 + blue];
+		}
+	}
+
+	// Converts a whole image into destination, which has to hold
+	// height rows of pitch bytes. Padding bytes are zeroed.
+	static void Convert(
+		const uint8_t *rgba,
+		std::size_t width,
+		std::size_t height,
+		Order order,
+		bool flip,
+		uint8_t *destination,
+		std::size_t pitch
+	) {
+		const auto padding = pitch - width * 3;
+
+		for (std::size_t y = 0; y < height; ++y) {
+			const auto source = rgba + (flip ? height - 1 - y : y) * width * 4;
+			auto row = destination + y * pitch;
+
+			ConvertRow(source, width, order, row);
+
+			if (padding > 0)
+				std::memset(row + width * 3, 0, padding);
+		}
+	}
+
+private:
+#if FETCKO_PIXEL_CONVERSION_SSSE3
+	// Asked once, the answer can't change while we run
+	static bool HasSsse3() {
+		static const bool supported = [] {
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 9)) != 0;
+#else
+			return __builtin_cpu_supports("ssse3") != 0;
+#endif
+		}();
+
+		return supported;
+	}
+
+	// Converts whole groups of 16 pixels, returning how many it did
+	FETCKO_TARGET_SSSE3 static std::size_t ConvertRowSsse3(const uint8_t *rgba, std::size_t width, Order order, uint8_t *destination) {
+		// Drops the alpha of four pixels, packing them into the low 12 bytes
+		const auto mask = order == Order::Rgb ?
+			_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1) :
+			_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+		std::size_t x = 0;
+
+		// 16 pixels in, 48 bytes out
+		for (; x + 16 <= width; x += 16) {
+			const auto source = reinterpret_cast<const __m128i *>(rgba + x * 4);
+			const auto a = _mm_shuffle_epi8(_mm_loadu_si128(source), mask);
+			const auto b = _mm_shuffle_epi8(_mm_loadu_si128(source + 1), mask);
+			const auto c = _mm_shuffle_epi8(_mm_loadu_si128(source + 2), mask);
+			const auto d = _mm_shuffle_epi8(_mm_loadu_si128(source + 3), mask);
+
+			const auto target = reinterpret_cast<__m128i *>(destination + x * 3);
+			_mm_storeu_si128(target, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+			_mm_storeu_si128(target + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+			_mm_storeu_si128(target + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+		}
+
+		return x;
+	}
+#endif
+};
+}
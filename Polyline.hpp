@@ -8,9 +8,15 @@
 // 
 // As such, rendering lines above a certain width (or
 // joined with acute angles) will cause visual issues.
+//
+// Every vertex also carries its signed distance from the line's center
+// and the line's half width (attribute 1), so that shaders/polyline_aa
+// can antialias the edges without a multisampled framebuffer. Give the
+// line a feather for that, to leave room for the fading edge.
 
 #include <cstddef>
 #include <deque>
+#include <optional>
 
 #include <glad/glad.h>
 
@@ -18,6 +24,7 @@
 
 #include "Buffer.hpp"
 #include "Context.hpp"
+#include "ScopedAlphaBlend.hpp"
 #include "VertexArray.hpp"
 
 #include "Utils/Logger.hpp"
@@ -51,6 +58,7 @@ public:
 
 	virtual ~Polyline() {
 		delete[] vertexBuffer;
+		delete[] edgeBuffer;
 		delete[] indexBuffer;
 	}
 
@@ -60,6 +68,12 @@ public:
 	const float GetWidth() const { return width; }
 	void SetWidth(float width) { this->width = width; }
 
+	// How far (usually in pixels) the geometry extends past
+	// each side of the line, for analytic antialiasing. Like
+	// the width, it applies to the points added after it.
+	const float GetFeather() const { return feather; }
+	void SetFeather(float feather) { this->feather = feather; }
+
 	// This is a very costly operation and should
 	// only be used to construct short polylines
 	template<Join J>
@@ -75,6 +89,11 @@ public:
 			delete[] this->vertexBuffer;
 			this->vertexBuffer = vertexBuffer;
 
+			auto edgeBuffer = new GLfloat[vertexCount + 8];
+			memcpy(edgeBuffer, this->edgeBuffer, vertexCount * sizeof(GLfloat));
+			delete[] this->edgeBuffer;
+			this->edgeBuffer = edgeBuffer;
+
 			if constexpr (J == Join::None) {
 				BetweenTwoPoints<true>(lastPoints.back(), point);
 			} else {
@@ -138,18 +157,21 @@ public:
 
 		if (size != this->size) {
 			delete[] vertexBuffer;
+			delete[] edgeBuffer;
 			delete[] indexBuffer;
 
 			indexCount = 0;
 
 			if constexpr (J == Join::None) {
 				vertexBuffer = new GLfloat[(size - 1) * 8];
+				edgeBuffer = new GLfloat[(size - 1) * 8];
 				indexBuffer = new GLushort[(size - 1) * 6];
 
 				for (std::size_t i = 1; i < size; ++i)
 					BetweenTwoPoints<true>(points[i - 1], points[i]);
 			} else {
 				vertexBuffer = new GLfloat[size * 8];
+				edgeBuffer = new GLfloat[size * 8];
 				indexBuffer = new GLushort[size * 6];
 
 				for (std::size_t i = 0; i < size; ++i) {
@@ -208,6 +230,11 @@ public:
 
 	template<bool LoadIdentity>
 	void Draw(Context &context) const {
+		// The feathered edges fade out through their alpha
+		std::optional<ScopedAlphaBlend> blend;
+		if (feather > 0.0f)
+			blend.emplace();
+
 		vao->Bind();
 		eab->Bind();
 		eab->DrawElements(GL_TRIANGLES);
@@ -224,6 +251,9 @@ private:
 		vertexCount = std::move(other.vertexCount);
 		vertexBuffer = std::move(other.vertexBuffer);
 		other.vertexBuffer = nullptr;
+		edgeBuffer = std::move(other.edgeBuffer);
+		other.edgeBuffer = nullptr;
+		feather = std::move(other.feather);
 		indexCount = std::move(other.indexCount);
 		indexBuffer = std::move(other.indexBuffer);
 		other.indexBuffer = nullptr;
@@ -231,6 +261,7 @@ private:
 		lastPoints = std::move(other.lastPoints);
 		size = std::move(other.size);
 		vbo = std::move(other.vbo);
+		edgeVbo = std::move(other.edgeVbo);
 		vao = std::move(other.vao);
 		eab = std::move(other.eab);
 	}
@@ -238,11 +269,14 @@ private:
 	inline void CreateArrayBuffer() {
 		vao = std::make_unique<VertexArray>();
 		vbo = std::make_unique<ArrayBuffer>();
+		edgeVbo = std::make_unique<ArrayBuffer>();
 
 		vao->Bind();
 		vbo->Bind();
 		vao->AddAttribute(VertexArray::Attribute(0, 2, 2 * sizeof(float)));
-		vbo->Unbind();
+		edgeVbo->Bind();
+		vao->AddAttribute(VertexArray::Attribute(1, 2, 2 * sizeof(float)));
+		edgeVbo->Unbind();
 		vao->Unbind();
 	}
 
@@ -250,6 +284,10 @@ private:
 		vbo->Bind();
 		vbo->BufferData(vertexBuffer, vertexCount);
 		vbo->Unbind();
+
+		edgeVbo->Bind();
+		edgeVbo->BufferData(edgeBuffer, vertexCount);
+		edgeVbo->Unbind();
 	}
 
 	inline void UpdateElementBuffer() {
@@ -278,22 +316,19 @@ private:
 		const Vector2f perpendicular{ -vector.y, vector.x };
 
 		const auto normal = perpendicular.Normalize();
+		const auto extent = width / 2 + feather;
 
 		// Top left
-		vertexBuffer[vertexCount++] = p1.x + normal.x * width / 2;
-		vertexBuffer[vertexCount++] = p1.y + normal.y * width / 2;
+		AddVertex(p1 + extent * normal, 1.0f);
 
 		// Top right
-		vertexBuffer[vertexCount++] = p2.x + normal.x * width / 2;
-		vertexBuffer[vertexCount++] = p2.y + normal.y * width / 2;
+		AddVertex(p2 + extent * normal, 1.0f);
 
 		// Bottom right
-		vertexBuffer[vertexCount++] = p2.x - normal.x * width / 2;
-		vertexBuffer[vertexCount++] = p2.y - normal.y * width / 2;
+		AddVertex(p2 - extent * normal, -1.0f);
 
 		// Bottom left
-		vertexBuffer[vertexCount++] = p1.x - normal.x * width / 2;
-		vertexBuffer[vertexCount++] = p1.y - normal.y * width / 2;
+		AddVertex(p1 - extent * normal, -1.0f);
 	}
 
 	template<bool UpdateIndices>
@@ -328,8 +363,8 @@ private:
 		// find length of miter by projecting the miter onto the normal,
 		// take the length of the projection, invert it and multiply it by the thickness:
 		//		length = thickness * ( 1 / |normal|.|miter| )
-		float length1 = width / 2.0f / normal.Dot(miter1);
-		float length2 = width / 2.0f / normal.Dot(miter2);
+		float length1 = (width / 2.0f + feather) / normal.Dot(miter1);
+		float length2 = (width / 2.0f + feather) / normal.Dot(miter2);
 
 		// Upper left
 		// p1 - length1 * miter1
@@ -350,28 +385,34 @@ private:
 			p2 - length2 * miter2
 		};
 
-		// Top left
-		vertexBuffer[vertexCount++] = quad[0].x;
-		vertexBuffer[vertexCount++] = quad[0].y;
-
-		// Top right
-		vertexBuffer[vertexCount++] = quad[1].x;
-		vertexBuffer[vertexCount++] = quad[1].y;
+		// The miters sit width / 2 + feather away from the
+		// line, measured along its normal, just like the
+		// corners of a quad without joins would
+		AddVertex(quad[0], -1.0f);
+		AddVertex(quad[1], 1.0f);
+		AddVertex(quad[2], 1.0f);
+		AddVertex(quad[3], -1.0f);
+	}
 
-		// Bottom right
-		vertexBuffer[vertexCount++] = quad[2].x;
-		vertexBuffer[vertexCount++] = quad[2].y;
+	// side is 1 or -1, depending on which side of the line the vertex is on
+	inline void AddVertex(const Vector2f &position, float side) {
+		edgeBuffer[vertexCount] = side * (width / 2 + feather);
+		edgeBuffer[vertexCount + 1] = width / 2;
 
-		// Bottom left
-		vertexBuffer[vertexCount++] = quad[3].x;
-		vertexBuffer[vertexCount++] = quad[3].y;
+		vertexBuffer[vertexCount++] = position.x;
+		vertexBuffer[vertexCount++] = position.y;
 	}
 
 	float width = 1.0f;
+	float feather = 0.0f;
 
 	GLushort vertexCount = 0;
 	GLfloat *vertexBuffer = nullptr;
 
+	// Signed distance from the center and half
+	// the width, for every vertex in vertexBuffer
+	GLfloat *edgeBuffer = nullptr;
+
 	GLsizei indexCount = 0;
 	GLushort *indexBuffer = nullptr;
 
@@ -389,5 +430,6 @@ private:
 
 	std::unique_ptr<VertexArray> vao;
 	std::unique_ptr<ArrayBuffer> vbo;
+	std::unique_ptr<ArrayBuffer> edgeVbo;
 	std::unique_ptr<ElementBuffer> eab;
 };
\ No newline at end of file
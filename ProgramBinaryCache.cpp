@@ -0,0 +1,150 @@
+#include "ProgramBinaryCache.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Fetcko {
+ProgramBinaryCache::ProgramBinaryCache(const std::filesystem::path &directory) :
+	directory(directory) {
+	for (const auto &name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		auto string = reinterpret_cast<const char *>(glGetString(name));
+		driver = Fnv1a::Hash(string ? string : "", driver);
+	}
+
+	const auto current = GetPath(0).parent_path();
+
+	std::error_code error;
+
+	std::filesystem::create_directories(current, error);
+
+	if (error) {
+		logger.LogError("Could not create program binary cache ", current.u8string(), ": ", error.message());
+		return;
+	}
+
+	// Other drivers may well still be in use (a software context next to
+	// the GPU, say), so their binaries only go once nobody has used them
+	// in a while. Marking ours as used keeps them from going stale.
+	const auto now = std::filesystem::file_time_type::clock::now();
+	std::filesystem::last_write_time(current, now, error);
+
+	std::vector<std::filesystem::path> stale;
+	for (const auto &iter : std::filesystem::directory_iterator(directory, error)) {
+		if (!iter.is_directory(error) || iter.path() == current)
+			continue;
+
+		const auto lastUsed = iter.last_write_time(error);
+		if (!error && now - lastUsed > MaxUnusedAge)
+			stale.emplace_back(iter.path());
+	}
+
+	for (const auto &path : stale) {
+		logger.LogInfo("Removing stale program binaries in ", path.u8string());
+		std::filesystem::remove_all(path, error);
+	}
+}
+
+bool ProgramBinaryCache::IsSupported() {
+	if (!GLAD_GL_ARB_get_program_binary)
+		return false;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+	return formats > 0;
+}
+
+std::uint64_t ProgramBinaryCache::GetKey(
+	const std::string &vertexSource,
+	const std::vector<std::string> &fragmentSources
+) const {
+	auto key = Fnv1a::Hash(vertexSource);
+
+	// Mix in the lengths as well so that moving
+	// text between stages changes the key
+	for (const auto &source : fragmentSources) {
+		auto size = static_cast<uint64_t>(source.size());
+		key = Fnv1a::Hash(&size, sizeof(size), key);
+		key = Fnv1a::Hash(source, key);
+	}
+
+	return key;
+}
+
+bool ProgramBinaryCache::Load(ShaderProgram &program, std::uint64_t key) const {
+	const auto path = GetPath(key);
+
+	std::ifstream inFile(path, std::ios::binary | std::ios::in);
+	if (!inFile)
+		return false;
+
+	Header header;
+	inFile.read(reinterpret_cast<char *>(&header), sizeof(Header));
+
+	if (!inFile ||
+		std::string_view(header.magic, 4) != std::string_view(Header().magic, 4) ||
+		header.version != Header().version ||
+		header.driver != driver ||
+		header.key != key) {
+		inFile.close();
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return false;
+	}
+
+	std::vector<uint8_t> binary(header.length);
+	inFile.read(reinterpret_cast<char *>(binary.data()), header.length);
+
+	if (!inFile || !program.LoadBinary(header.format, binary)) {
+		logger.LogWarning("Discarding rejected program binary ", path.u8string());
+		inFile.close();
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		return false;
+	}
+
+	return true;
+}
+
+void ProgramBinaryCache::Store(const ShaderProgram &program, std::uint64_t key) const {
+	auto binary = program.GetBinary();
+	if (!binary)
+		return;
+
+	Header header;
+	header.driver = driver;
+	header.key = key;
+	header.format = binary->first;
+	header.length = static_cast<uint32_t>(binary->second.size());
+
+	// Write to a temporary file first so that a crash
+	// (or a second process) never sees a partial binary
+	const auto path = GetPath(key);
+	auto temporary = path;
+	temporary += ".tmp";
+
+	std::ofstream outFile(temporary, std::ios::binary | std::ios::out);
+	outFile.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+	outFile.write(reinterpret_cast<const char *>(binary->second.data()), binary->second.size());
+	outFile.close();
+
+	std::error_code error;
+
+	if (outFile)
+		std::filesystem::rename(temporary, path, error);
+
+	if (!outFile || error) {
+		logger.LogWarning("Could not store program binary ", path.u8string());
+		std::filesystem::remove(temporary, error);
+	}
+}
+
+std::filesystem::path ProgramBinaryCache::GetPath(std::uint64_t key) const {
+	std::stringstream driverName, keyName;
+	driverName << std::hex << std::setw(16) << std::setfill('0') << driver;
+	keyName << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+
+	return directory / driverName.str() / keyName.str();
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Fnv1a.hpp"
+#include "Logger.hpp"
+#include "ShaderProgram.hpp"
+
+namespace Fetcko {
+// Keeps linked program binaries on disk so that subsequent
+// runs can skip compiling and linking entirely.
+//
+// Binaries are stored as <directory>/<driver hash>/<source hash>.bin,
+// where the driver hash covers GL_VENDOR, GL_RENDERER and GL_VERSION.
+// Directories of other drivers are left alone (another process may be
+// using them) until they have gone unused for MaxUnusedAge, so a driver
+// update eventually drops the old binaries.
+class ProgramBinaryCache : public LoggableClass {
+public:
+	explicit ProgramBinaryCache(const std::filesystem::path &directory);
+
+	// The driver has to support GL_ARB_get_program_binary
+	// and expose at least one binary format
+	static bool IsSupported();
+
+	std::uint64_t GetKey(
+		const std::string &vertexSource,
+		const std::vector<std::string> &fragmentSources
+	) const;
+
+	bool Load(ShaderProgram &program, std::uint64_t key) const;
+	void Store(const ShaderProgram &program, std::uint64_t key) const;
+
+private:
+	static constexpr auto MaxUnusedAge = std::chrono::hours(24 * 30);
+
+#pragma pack (push, 1)
+	struct [[gnu::packed]] Header {
+		char magic[4] = { 'F', 'P', 'B', 'C' };
+		uint32_t version = 1;
+		uint64_t driver = 0;
+		uint64_t key = 0;
+		uint32_t format = 0;
+		uint32_t length = 0;
+	};
+#pragma pack (pop)
+
+	std::filesystem::path GetPath(std::uint64_t key) const;
+
+	std::filesystem::path directory;
+
+	uint64_t driver = Fnv1a::Basis;
+};
+}
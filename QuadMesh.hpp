@@ -0,0 +1,111 @@
+#pragma once
+
+#include <iterator>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Buffer.hpp"
+#include "ShaderProgram.hpp"
+#include "VertexArray.hpp"
+
+namespace Fetcko {
+// The textured quad framebuffers are drawn with. Each Context owns one
+// shared by all of its framebuffers, rather than a VAO, VBO and EBO per
+// framebuffer. It's a unit quad that gets sized through the projection
+// uniform, so drawing it at different sizes never touches its vertices.
+//
+// Shaders can declare
+//
+//     uniform vec2 texCoordScale = vec2(1.0);
+//
+// and multiply their texture coordinates by it, which is how the part
+// of the texture shown gets picked. For shaders that don't, the texture
+// coordinates get rewritten instead whenever that part changes.
+class QuadMesh {
+public:
+	QuadMesh() {
+		vao.Bind();
+
+		positions.Bind();
+		positions.BufferData<std::size(Buffers::TexCoordBuffer)>(Buffers::TexCoordBuffer);
+		vao.AddAttribute(VertexArray::Attribute(0, 2));
+
+		texCoords.Bind();
+		texCoords.BufferData<std::size(Buffers::TexCoordBuffer)>(Buffers::TexCoordBuffer, GL_DYNAMIC_DRAW);
+		vao.AddAttribute(VertexArray::Attribute(1, 2));
+
+		texCoords.Unbind();
+		vao.Unbind();
+
+		eab.Bind();
+		eab.BufferData<std::size(Buffers::SquareBuffer)>(Buffers::SquareBuffer);
+		eab.Unbind();
+	}
+
+	// Draws a width x height quad at the origin of projection, showing
+	// the bottom left u x v of the bound texture. The program's uniforms
+	// are left as they were.
+	void Draw(
+		ShaderProgram &program,
+		const glm::mat4 &projection,
+		GLfloat width,
+		GLfloat height,
+		GLfloat u = 1.0f,
+		GLfloat v = 1.0f
+	) {
+		const auto scaled = program.GetUniformLocation<true>("texCoordScale") != static_cast<GLuint>(-1);
+
+		if (scaled)
+			program.Uniform2f("texCoordScale", u, v);
+
+		program.UniformMatrix4fv("projection", 1, GL_FALSE, glm::scale(projection, glm::vec3(width, height, 1.0f)));
+
+		vao.Bind();
+
+		if (scaled)
+			SetTexCoordScale(1.0f, 1.0f);
+		else
+			SetTexCoordScale(u, v);
+
+		eab.Bind();
+		eab.DrawElements(GL_TRIANGLES);
+		eab.Unbind();
+		vao.Unbind();
+
+		program.UniformMatrix4fv("projection", 1, GL_FALSE, projection);
+
+		if (scaled)
+			program.Uniform2f("texCoordScale", 1.0f, 1.0f);
+	}
+
+private:
+	// Only rewrites the texture coordinates if they change
+	void SetTexCoordScale(GLfloat u, GLfloat v) {
+		if (u == texCoordScale[0] && v == texCoordScale[1])
+			return;
+
+		float buffer[std::size(Buffers::TexCoordBuffer)];
+		for (std::size_t i = 0; i < std::size(buffer); i += 2) {
+			buffer[i] = Buffers::TexCoordBuffer[i] * u;
+			buffer[i + 1] = Buffers::TexCoordBuffer[i + 1] * v;
+		}
+
+		// Orphaned, so we never wait on the draws still using them
+		texCoords.Bind();
+		texCoords.Stream(buffer, std::size(buffer), GL_DYNAMIC_DRAW);
+		texCoords.Unbind();
+
+		texCoordScale[0] = u;
+		texCoordScale[1] = v;
+	}
+
+	VertexArray vao;
+	ArrayBuffer positions;
+	ArrayBuffer texCoords;
+	ElementBuffer eab;
+
+	// What the texture coordinates currently hold
+	float texCoordScale[2] = { 1.0f, 1.0f };
+};
+}
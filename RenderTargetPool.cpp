@@ -0,0 +1,45 @@
+#include "RenderTargetPool.hpp"
+
+#include <algorithm>
+
+namespace Fetcko {
+RenderTargetPool::RenderTargetPool(std::size_t maxIdle) : maxIdle(maxIdle) {
+
+}
+
+void RenderTargetPool::Clear() {
+	statistics.evictions += idle.size();
+	idle.clear();
+}
+
+void RenderTargetPool::SetMaxIdle(std::size_t maxIdle) {
+	this->maxIdle = maxIdle;
+	Trim();
+}
+
+GLsizei RenderTargetPool::Bucket(GLsizei size) {
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+	if (size <= 0 || size > maxSize)
+		return 0;
+
+	GLsizei ret = std::min(MinimumSize, maxSize);
+
+	// Clamped, as the limit doesn't have to be a power of two
+	while (ret < size)
+		ret = std::min(ret * 2, maxSize);
+
+	return ret;
+}
+
+void RenderTargetPool::Trim() {
+	if (idle.size() <= maxIdle)
+		return;
+
+	const auto excess = idle.size() - maxIdle;
+
+	idle.erase(idle.begin(), idle.begin() + excess);
+	statistics.evictions += excess;
+}
+}
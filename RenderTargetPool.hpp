@@ -0,0 +1,227 @@
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "Framebuffer.hpp"
+#include "Logger.hpp"
+#include "SavedRenderState.hpp"
+
+namespace Fetcko {
+// Hands out framebuffers for offscreen passes and takes them back once
+// they're done with, so that rendering into a temporary target doesn't
+// create (and delete) a texture, an FBO and so on every time. Sizes are
+// rounded up to powers of two to make reuse likely; the target's content
+// size is set to what was asked for. Reused targets aren't cleared, but
+// BeginRender() takes care of that.
+//
+// Leases must not outlive the pool they came from.
+class RenderTargetPool : public LoggableClass {
+public:
+	struct Key {
+		GLsizei width;
+		GLsizei height;
+		GLint format;
+		GLsizei samples;
+		GLenum depthStencilFormat;
+		GLbitfield invalidateAfterBlit;
+
+		bool operator==(const Key &right) const {
+			return
+				std::tie(width, height, format, samples, depthStencilFormat, invalidateAfterBlit) ==
+				std::tie(right.width, right.height, right.format, right.samples, right.depthStencilFormat, right.invalidateAfterBlit);
+		}
+	};
+
+	template<bool Multisampled>
+	class Lease {
+	public:
+		Lease() = default;
+
+		Lease(Lease &&other) noexcept :
+			pool(other.pool),
+			key(other.key),
+			target(std::move(other.target)) {
+			other.pool = nullptr;
+		}
+
+		Lease &operator=(Lease &&right) noexcept {
+			if (this != &right) {
+				Release();
+
+				pool = right.pool;
+				key = right.key;
+				target = std::move(right.target);
+				right.pool = nullptr;
+			}
+
+			return *this;
+		}
+
+		~Lease() {
+			Release();
+		}
+
+		// Gives the target back to the pool early
+		void Release() {
+			if (pool && target)
+				pool->Return(key, std::move(target));
+
+			pool = nullptr;
+		}
+
+		// Binds the target and clears its content area, which the viewport
+		// and scissor box are restricted to until EndRender() puts back
+		// whatever was bound and set before (so leases can nest)
+		void BeginRender() {
+			oldState.Save();
+
+			target->Bind();
+
+			SavedRenderState::BeginArea(
+				0,
+				0,
+				target->GetContentWidth(),
+				target->GetContentHeight(),
+				target->GetDepthStencilFormat() == GL_NONE ?
+				GL_COLOR_BUFFER_BIT :
+				GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT
+			);
+		}
+
+		void EndRender() {
+			oldState.Restore();
+		}
+
+		Framebuffer<Multisampled> &operator*() const { return *target; }
+		Framebuffer<Multisampled> *operator->() const { return target.get(); }
+		Framebuffer<Multisampled> *Get() const { return target.get(); }
+
+		explicit operator bool() const { return static_cast<bool>(target); }
+
+	private:
+		friend class RenderTargetPool;
+
+		Lease(RenderTargetPool *pool, const Key &key, std::unique_ptr<Framebuffer<Multisampled>> &&target) :
+			pool(pool),
+			key(key),
+			target(std::move(target)) {
+		}
+
+		RenderTargetPool *pool = nullptr;
+		Key key{};
+		std::unique_ptr<Framebuffer<Multisampled>> target;
+
+		SavedRenderState oldState;
+	};
+
+	struct Statistics {
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t evictions = 0;
+	};
+
+	// Keeps at most maxIdle released targets around
+	explicit RenderTargetPool(std::size_t maxIdle = 8);
+
+	// Returns an empty lease for sizes that aren't
+	// positive or don't fit into a texture
+	template<bool Multisampled = false>
+	Lease<Multisampled> Acquire(
+		GLsizei width,
+		GLsizei height,
+		GLint format = GL_RGBA,
+		const typename Framebuffer<Multisampled>::Options &options = {}
+	) {
+		const Key key{
+			Bucket(width),
+			Bucket(height),
+			format,
+			Multisampled ? options.samples : 0,
+			options.depthStencilFormat,
+			options.invalidateAfterBlit
+		};
+
+		if (key.width == 0 || key.height == 0) {
+			logger.LogError("Cannot render into a target of ", width, "x", height);
+			return {};
+		}
+
+		std::unique_ptr<Framebuffer<Multisampled>> target;
+
+		// Most recently released first, it's the likeliest to still be resident
+		for (auto iter = idle.rbegin(); iter != idle.rend(); ++iter) {
+			auto &candidate = std::get<std::unique_ptr<Framebuffer<Multisampled>>>(iter->targets);
+
+			if (candidate && iter->key == key) {
+				target = std::move(candidate);
+				idle.erase(std::next(iter).base());
+				break;
+			}
+		}
+
+		if (target) {
+			++statistics.hits;
+		} else {
+			++statistics.misses;
+
+			// Creating a framebuffer leaves 0 bound, which would pull
+			// the rug out from under an enclosing lease's pass
+			SavedRenderState state;
+			state.Save();
+
+			target = std::make_unique<Framebuffer<Multisampled>>(key.width, key.height, format, options);
+
+			state.Restore();
+		}
+
+		target->SetContentSize(width, height);
+
+		return Lease<Multisampled>(this, key, std::move(target));
+	}
+
+	// Deletes every idle target
+	void Clear();
+
+	void SetMaxIdle(std::size_t maxIdle);
+
+	std::size_t GetIdleCount() const { return idle.size(); }
+	const Statistics &GetStatistics() const { return statistics; }
+
+private:
+	// Smallest power of two no smaller than size, and at least MinimumSize,
+	// but no larger than GL_MAX_TEXTURE_SIZE. 0 for sizes that can't be had.
+	static GLsizei Bucket(GLsizei size);
+
+	static constexpr GLsizei MinimumSize = 32;
+
+	template<bool Multisampled>
+	void Return(const Key &key, std::unique_ptr<Framebuffer<Multisampled>> &&target) {
+		Idle entry{ key };
+		std::get<std::unique_ptr<Framebuffer<Multisampled>>>(entry.targets) = std::move(target);
+
+		idle.emplace_back(std::move(entry));
+		Trim();
+	}
+
+	// Drops the least recently released targets over the limit
+	void Trim();
+
+	struct Idle {
+		Key key;
+
+		// Only the one of the type it was acquired as is set
+		std::tuple<
+			std::unique_ptr<FramebufferObject>,
+			std::unique_ptr<MultisampledFramebufferObject>
+		> targets;
+	};
+
+	// Least recently released first
+	std::vector<Idle> idle;
+	std::size_t maxIdle;
+
+	Statistics statistics;
+};
+}
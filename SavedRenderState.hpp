@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace Fetcko {
+// What an offscreen pass changes and the code around it may rely on:
+// the bound framebuffers, the viewport, the scissor test and box, and
+// the clear color. Saving before binding the target and restoring after
+// lets passes nest, e.g. caching text while rendering into a pool lease.
+class SavedRenderState {
+public:
+	// Call before binding the pass's target
+	void Save() {
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetIntegerv(GL_SCISSOR_BOX, scissorBox);
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+		scissor = glIsEnabled(GL_SCISSOR_TEST);
+	}
+
+	void Restore() const {
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glScissor(scissorBox[0], scissorBox[1], scissorBox[2], scissorBox[3]);
+		glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+
+		if (scissor)
+			glEnable(GL_SCISSOR_TEST);
+		else
+			glDisable(GL_SCISSOR_TEST);
+	}
+
+	// Restricts drawing (and clearing) to an area of the bound
+	// framebuffer, and clears it to transparent black
+	static void BeginArea(GLint x, GLint y, GLsizei width, GLsizei height, GLbitfield clearMask = GL_COLOR_BUFFER_BIT) {
+		glViewport(x, y, width, height);
+		glScissor(x, y, width, height);
+		glEnable(GL_SCISSOR_TEST);
+
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(clearMask);
+	}
+
+private:
+	GLint drawFramebuffer = 0;
+	GLint readFramebuffer = 0;
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	GLint scissorBox[4] = { 0, 0, 0, 0 };
+	GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	GLboolean scissor = GL_FALSE;
+};
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace Fetcko {
+// Turns on straight alpha blending for as long as it lives, then puts
+// back whatever blending was enabled (and with which functions) before
+class ScopedAlphaBlend {
+public:
+	ScopedAlphaBlend() {
+		enabled = glIsEnabled(GL_BLEND);
+		glGetIntegerv(GL_BLEND_SRC_RGB, &sourceRgb);
+		glGetIntegerv(GL_BLEND_DST_RGB, &destinationRgb);
+		glGetIntegerv(GL_BLEND_SRC_ALPHA, &sourceAlpha);
+		glGetIntegerv(GL_BLEND_DST_ALPHA, &destinationAlpha);
+
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+
+	ScopedAlphaBlend(const ScopedAlphaBlend &) = delete;
+	ScopedAlphaBlend &operator=(const ScopedAlphaBlend &) = delete;
+
+	~ScopedAlphaBlend() {
+		glBlendFuncSeparate(sourceRgb, destinationRgb, sourceAlpha, destinationAlpha);
+
+		if (!enabled)
+			glDisable(GL_BLEND);
+	}
+
+private:
+	GLboolean enabled = GL_FALSE;
+	GLint sourceRgb = GL_ONE;
+	GLint destinationRgb = GL_ZERO;
+	GLint sourceAlpha = GL_ONE;
+	GLint destinationAlpha = GL_ZERO;
+};
+}
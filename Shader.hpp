@@ -23,7 +23,10 @@ public:
 	}
 
 	bool Compile(const std::filesystem::path &path) {
-		auto string = Utils::GetStringFromFile(path);
+		return CompileSource(Utils::GetStringFromFile(path));
+	}
+
+	bool CompileSource(const std::string &string) {
 		auto source = string.c_str();
 
 		int ret;
@@ -0,0 +1,186 @@
+#include "ShaderPreprocessor.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include "Utils.hpp"
+
+namespace Fetcko {
+namespace {
+// Returns the remainder of the line if it is the given
+// directive (ignoring whitespace around the '#')
+std::optional<std::string_view> GetDirective(std::string_view line, std::string_view directive) {
+	auto start = line.find_first_not_of(" \t");
+	if (start == std::string_view::npos || line[start] != '#')
+		return std::nullopt;
+
+	line.remove_prefix(start + 1);
+	line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+
+	if (line.substr(0, directive.size()) != directive)
+		return std::nullopt;
+
+	line.remove_prefix(directive.size());
+
+	// Make sure we didn't just match a prefix, e.g. #includes
+	if (!line.empty() && line[0] != ' ' && line[0] != '\t' && line[0] != '"' && line[0] != '<')
+		return std::nullopt;
+
+	return line;
+}
+
+// Skips whitespace and comments at the start of the line, keeping
+// track of block comments that carry on into the next one. Returns
+// whatever comes after them (empty for a blank or comment-only line).
+std::string_view SkipComments(std::string_view line, bool &inComment) {
+	while (true) {
+		if (inComment) {
+			auto end = line.find("*/");
+			if (end == std::string_view::npos)
+				return {};
+
+			line.remove_prefix(end + 2);
+			inComment = false;
+		}
+
+		line.remove_prefix(std::min(line.find_first_not_of(" \t\r"), line.size()));
+
+		if (line.substr(0, 2) == "//")
+			return {};
+
+		if (line.substr(0, 2) != "/*")
+			return line;
+
+		line.remove_prefix(2);
+		inComment = true;
+	}
+}
+}
+
+std::optional<std::string> ShaderPreprocessor::Process(
+	const std::filesystem::path &path,
+	const ShaderDefines &defines
+) {
+	std::string source;
+	std::vector<std::filesystem::path> stack;
+
+	included.clear();
+	sources.clear();
+
+	if (!Include(path, source, stack))
+		return std::nullopt;
+
+	if (defines.empty())
+		return source;
+
+	std::string injected;
+	for (const auto &[name, value] : defines)
+		injected += "#define " + name + (value.empty() ? "" : " " + value) + "\n";
+
+	// #version has to stay the first statement,
+	// though comments may come before it
+	std::size_t offset = 0;
+	std::size_t lines = 0;
+	bool inComment = false;
+	std::istringstream stream(source);
+	for (std::string line; std::getline(stream, line); ) {
+		offset += line.size() + 1;
+		++lines;
+
+		const auto statement = SkipComments(line, inComment);
+
+		if (GetDirective(statement, "version")) {
+			injected += "#line " + std::to_string(lines + 1) + "\n";
+			return source.insert(std::min(offset, source.size()), injected);
+		}
+
+		if (!statement.empty())
+			break;
+	}
+
+	injected += "#line 1\n";
+	return injected + source;
+}
+
+std::string ShaderPreprocessor::GetKey(const ShaderDefines &defines) {
+	std::string key;
+
+	for (const auto &[name, value] : defines) {
+		key += name;
+		key += '=';
+		key += value;
+		key += ';';
+	}
+
+	return key;
+}
+
+bool ShaderPreprocessor::Include(
+	const std::filesystem::path &path,
+	std::string &output,
+	std::vector<std::filesystem::path> &stack
+) {
+	auto canonical = std::filesystem::weakly_canonical(path);
+
+	if (std::find(stack.begin(), stack.end(), canonical) != stack.end()) {
+		logger.LogError("Recursive #include of ", path.u8string());
+		return false;
+	}
+
+	if (std::find(included.begin(), included.end(), canonical) != included.end())
+		return true;
+
+	if (!std::filesystem::exists(path)) {
+		logger.LogError("Could not find shader ", path.u8string());
+		return false;
+	}
+
+	// The file being processed keeps 0, so its #version stays first
+	const auto number = std::to_string(sources.size());
+	sources.emplace_back(path);
+
+	if (!stack.empty())
+		output += "#line 1 " + number + "\n";
+
+	stack.emplace_back(canonical);
+
+	auto source = Utils::GetStringFromFile(path);
+
+	std::size_t lines = 0;
+	std::istringstream stream(source);
+	for (std::string line; std::getline(stream, line); ) {
+		++lines;
+
+		if (auto pragma = GetDirective(line, "pragma"); pragma && pragma->find("once") != std::string_view::npos) {
+			included.emplace_back(canonical);
+			continue;
+		}
+
+		if (auto include = GetDirective(line, "include")) {
+			auto first = include->find('"');
+			auto last = include->rfind('"');
+
+			if (first == std::string_view::npos || first == last) {
+				logger.LogError("Malformed #include in ", path.u8string(), ":", lines);
+				return false;
+			}
+
+			auto file = path.parent_path() / std::string(include->substr(first + 1, last - first - 1));
+
+			if (!Include(file, output, stack))
+				return false;
+
+			// Keep compiler errors pointing at the right line
+			output += "#line " + std::to_string(lines + 1) + " " + number + "\n";
+			continue;
+		}
+
+		output += line;
+		output += '\n';
+	}
+
+	stack.pop_back();
+
+	return true;
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Logger.hpp"
+
+namespace Fetcko {
+// Sorted, so the same set of defines always
+// produces the same source (and variant key)
+using ShaderDefines = std::map<std::string, std::string>;
+
+class ShaderPreprocessor : public LoggableClass {
+public:
+	// Resolves #include "file" directives (relative to the including
+	// file) and injects the provided defines right after #version.
+	// Files containing "#pragma once" are only included once.
+	// Returns nothing if a file is missing or includes itself.
+	std::optional<std::string> Process(
+		const std::filesystem::path &path,
+		const ShaderDefines &defines = {}
+	);
+
+	// The files read by the last Process(), indexed by the source string
+	// number their #line directives use (and compiler errors report)
+	const std::vector<std::filesystem::path> &GetSources() const { return sources; }
+
+	// Canonical string for a set of defines,
+	// suitable for use as a cache key
+	static std::string GetKey(const ShaderDefines &defines);
+
+private:
+	bool Include(
+		const std::filesystem::path &path,
+		std::string &output,
+		std::vector<std::filesystem::path> &stack
+	);
+
+	std::vector<std::filesystem::path> included;
+	std::vector<std::filesystem::path> sources;
+};
+}
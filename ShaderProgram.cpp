@@ -13,13 +13,15 @@ ShaderProgram::ShaderProgram(ShaderProgram &&other) noexcept {
 	fragmentShaders = std::move(other.fragmentShaders);
 
 	uniforms = std::move(other.uniforms);
+
+	linked = other.linked;
 }
 
 ShaderProgram::~ShaderProgram() {
 	glDeleteProgram(handle);
 }
 
-void ShaderProgram::Attach(
+bool ShaderProgram::Attach(
 	const VertexShader &vertexShader,
 	const std::vector<FragmentShader> &fragmentShaders
 ) {
@@ -31,6 +33,10 @@ void ShaderProgram::Attach(
 	for (const auto &fragment : fragmentShaders)
 		glAttachShader(handle, fragment.GetHandle());
 
+	// Some drivers only keep the binary around if asked to before linking
+	if (GLAD_GL_ARB_get_program_binary)
+		glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	int ret;
 
 	glLinkProgram(handle);
@@ -45,6 +51,44 @@ void ShaderProgram::Attach(
 
 		logger.LogError("Shader linking failed:\n", std::string(infoLog.begin(), infoLog.end()));
 	}
+
+	linked = ret != 0;
+
+	return linked;
+}
+
+bool ShaderProgram::LoadBinary(GLenum format, const std::vector<uint8_t> &binary) {
+	if (!GLAD_GL_ARB_get_program_binary)
+		return false;
+
+	int ret;
+
+	glProgramBinary(handle, format, binary.data(), static_cast<GLsizei>(binary.size()));
+	glGetProgramiv(handle, GL_LINK_STATUS, &ret);
+
+	// Not an error; the driver is free to reject
+	// binaries it produced itself (e.g. after an update)
+	linked = ret != 0;
+
+	return linked;
+}
+
+std::optional<std::pair<GLenum, std::vector<uint8_t>>> ShaderProgram::GetBinary() const {
+	if (!GLAD_GL_ARB_get_program_binary || !linked)
+		return std::nullopt;
+
+	GLint length = 0;
+	glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return std::nullopt;
+
+	GLenum format = 0;
+	std::vector<uint8_t> binary(length);
+	glGetProgramBinary(handle, length, &length, &format, binary.data());
+	binary.resize(length);
+
+	return std::make_pair(format, std::move(binary));
 }
 
 void ShaderProgram::Use() const {
@@ -15,11 +15,19 @@ public:
 
 	virtual ~ShaderProgram();
 
-	void Attach(
+	bool Attach(
 		const VertexShader &vertexShader,
 		const std::vector<FragmentShader> &fragmentShaders
 	);
 
+	// Links the program straight from a driver-specific binary
+	// previously returned by GetBinary(). Fails (and leaves the
+	// program unlinked) if the driver rejects the binary.
+	bool LoadBinary(GLenum format, const std::vector<uint8_t> &binary);
+	std::optional<std::pair<GLenum, std::vector<uint8_t>>> GetBinary() const;
+
+	const bool IsLinked() const { return linked; }
+
 	void Use() const;
 
 	const GLuint &GetHandle() const;
@@ -58,5 +66,7 @@ private:
 	std::optional<std::reference_wrapper<const std::vector<FragmentShader>>> fragmentShaders = std::nullopt;
 
 	std::map<std::string, GLuint> uniforms;
+
+	bool linked = false;
 };
 }
\ No newline at end of file
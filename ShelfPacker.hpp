@@ -0,0 +1,91 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+namespace Fetcko {
+// Packs rectangles into fixed-size bins by placing them left to
+// right on horizontal shelves. A new shelf is opened (at the bottom
+// of the last one) when a rectangle doesn't fit any existing shelf.
+//
+// Glyphs and text runs have similar heights, so this wastes very
+// little space and is a lot cheaper than a general-purpose packer.
+class ShelfPacker {
+public:
+	struct Rect {
+		int x = 0, y = 0, width = 0, height = 0;
+	};
+
+	ShelfPacker() = default;
+	ShelfPacker(int width, int height, int padding = 0) :
+		width(width),
+		height(height),
+		padding(padding) {
+
+	}
+
+	std::optional<Rect> Pack(int width, int height) {
+		const auto paddedWidth = width + padding;
+		const auto paddedHeight = height + padding;
+
+		if (paddedWidth > this->width || paddedHeight > this->height)
+			return std::nullopt;
+
+		// Best fit: the shortest shelf that can hold us
+		Shelf *best = nullptr;
+		for (auto &shelf : shelves) {
+			if (shelf.height >= paddedHeight && this->width - shelf.x >= paddedWidth) {
+				if (!best || shelf.height < best->height)
+					best = &shelf;
+			}
+		}
+
+		// Don't waste a tall shelf on a short rectangle
+		// if we can still open a better fitting one
+		if (!best || (best->height > paddedHeight * 2 && bottom + paddedHeight <= this->height)) {
+			if (bottom + paddedHeight > this->height) {
+				if (!best)
+					return std::nullopt;
+			} else {
+				best = &shelves.emplace_back(Shelf{ bottom, paddedHeight, 0 });
+				bottom += paddedHeight;
+			}
+		}
+
+		Rect ret{ best->x, best->y, width, height };
+		best->x += paddedWidth;
+
+		used += paddedWidth * paddedHeight;
+
+		return ret;
+	}
+
+	void Clear() {
+		shelves.clear();
+		bottom = 0;
+		used = 0;
+	}
+
+	const int GetWidth() const { return width; }
+	const int GetHeight() const { return height; }
+
+	// Fraction of the bin covered by packed rectangles
+	const float GetOccupancy() const {
+		return static_cast<float>(used) / (static_cast<float>(width) * height);
+	}
+
+private:
+	struct Shelf {
+		int y = 0, height = 0, x = 0;
+	};
+
+	int width = 0;
+	int height = 0;
+	int padding = 0;
+
+	int bottom = 0;
+	long long used = 0;
+
+	std::vector<Shelf> shelves;
+};
+}
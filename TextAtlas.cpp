@@ -0,0 +1,164 @@
+#include "TextAtlas.hpp"
+
+namespace Fetcko {
+TextAtlas::Page::Page(GLsizei size, int padding) :
+	framebuffer(std::make_unique<FramebufferObject>(size, size)),
+	packer(size, size, padding) {
+
+}
+
+TextAtlas::TextAtlas(GLsizei pageSize, std::size_t maxPages, int padding) :
+	pageSize(pageSize),
+	maxPages(maxPages),
+	padding(padding) {
+	vao.Bind();
+	vbo.Bind();
+	vao.AddAttribute(VertexArray::Attribute(0, 2, 4 * sizeof(float)));
+	vao.AddAttribute(VertexArray::Attribute(1, 2, 4 * sizeof(float), 2 * sizeof(float)));
+	vbo.Unbind();
+	vao.Unbind();
+}
+
+std::optional<TextAtlas::Entry> TextAtlas::Allocate(GLsizei width, GLsizei height) {
+	if (width + padding > pageSize || height + padding > pageSize) {
+		logger.LogError("Text of ", width, "x", height, " does not fit into a ", pageSize, "x", pageSize, " atlas page");
+		return std::nullopt;
+	}
+
+	Entry ret;
+
+	for (auto &page : pages) {
+		if (auto rect = page.packer.Pack(width, height)) {
+			ret.generation = page.generation;
+			ret.rect = *rect;
+			return ret;
+		}
+		++ret.page;
+	}
+
+	if (pages.size() < maxPages) {
+		// Creating its framebuffer leaves 0 bound, while
+		// whatever the caller is rendering to should stay
+		SavedRenderState state;
+		state.Save();
+
+		pages.emplace_back(pageSize, padding);
+
+		state.Restore();
+	} else {
+		// Evict the least recently drawn page, as long as
+		// nothing queued still needs to be read from it
+		Page *lru = nullptr;
+		for (auto &page : pages) {
+			if (page.vertices.empty() && (!lru || page.lastUsed < lru->lastUsed))
+				lru = &page;
+		}
+
+		if (!lru) {
+			logger.LogError("Every text atlas page is in use!");
+			return std::nullopt;
+		}
+
+		lru->packer.Clear();
+		++lru->generation;
+
+		ret.page = lru - pages.data();
+	}
+
+	auto &page = pages[ret.page];
+
+	ret.generation = page.generation;
+	ret.rect = *page.packer.Pack(width, height);
+
+	return ret;
+}
+
+void TextAtlas::BeginRender(const Entry &entry) {
+	auto &page = pages.at(entry.page);
+	const auto &rect = entry.rect;
+
+	oldState.Save();
+
+	page.framebuffer->Bind();
+
+	SavedRenderState::BeginArea(rect.x, rect.y, rect.width, rect.height);
+}
+
+void TextAtlas::EndRender() {
+	oldState.Restore();
+}
+
+void TextAtlas::Queue(const Entry &entry, glm::vec2 position) {
+	auto &page = pages.at(entry.page);
+	const auto &rect = entry.rect;
+
+	page.lastUsed = ++tick;
+
+	const auto size = static_cast<float>(pageSize);
+
+	const auto left = position.x;
+	const auto top = position.y;
+	const auto right = left + rect.width;
+	const auto bottom = top + rect.height;
+
+	const auto u0 = rect.x / size;
+	const auto v0 = rect.y / size;
+	const auto u1 = (rect.x + rect.width) / size;
+	const auto v1 = (rect.y + rect.height) / size;
+
+	// Same orientation as Framebuffer::Draw()
+	page.vertices.insert(page.vertices.end(), {
+		left,  top,    u0, v0,
+		left,  bottom, u0, v1,
+		right, bottom, u1, v1,
+
+		left,  top,    u0, v0,
+		right, bottom, u1, v1,
+		right, top,    u1, v0
+	});
+}
+
+std::size_t TextAtlas::Flush(const glm::mat4 &projection, Context &context) {
+	stream.clear();
+	for (const auto &page : pages)
+		stream.insert(stream.end(), page.vertices.begin(), page.vertices.end());
+
+	if (stream.empty())
+		return 0;
+
+	context.GetShaderProgram().UniformMatrix4fv(
+		"projection",
+		1,
+		GL_FALSE,
+		projection
+	);
+
+	vao.Bind();
+	vbo.Bind();
+	vbo.Stream(stream);
+
+	std::size_t ret = 0;
+
+	GLint first = 0;
+	for (auto &page : pages) {
+		const auto count = static_cast<GLsizei>(page.vertices.size() / 4);
+
+		if (count > 0) {
+			page.framebuffer->GetTexture().Bind();
+			vbo.DrawArrays(GL_TRIANGLES, first, count);
+			++ret;
+		}
+
+		first += count;
+		page.vertices.clear();
+	}
+
+	vbo.Unbind();
+	vao.Unbind();
+
+	// Put back whatever the context had
+	context.Apply();
+
+	return ret;
+}
+}
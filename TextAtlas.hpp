@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Buffer.hpp"
+#include "Context.hpp"
+#include "Framebuffer.hpp"
+#include "Logger.hpp"
+#include "SavedRenderState.hpp"
+#include "ShelfPacker.hpp"
+#include "VertexArray.hpp"
+
+namespace Fetcko {
+// A handful of large render targets that pre-rendered strings
+// are packed into, so that caching text doesn't need a framebuffer
+// per string and drawing cached text can be batched.
+//
+// Space is reclaimed a whole page at a time: when nothing fits, the
+// least recently drawn page is cleared and its generation bumped,
+// which invalidates every entry that lived on it.
+class TextAtlas : public LoggableClass {
+public:
+	struct Entry {
+		std::size_t page = 0;
+		uint64_t generation = 0;
+		ShelfPacker::Rect rect;
+	};
+
+	explicit TextAtlas(GLsizei pageSize = 2048, std::size_t maxPages = 4, int padding = 1);
+
+	std::optional<Entry> Allocate(GLsizei width, GLsizei height);
+
+	// Entries are invalidated when their page gets evicted
+	const bool IsValid(const Entry &entry) const {
+		return entry.page < pages.size() && pages[entry.page].generation == entry.generation;
+	}
+
+	// Binds the page and restricts drawing (and clearing) to
+	// the entry, until EndRender() restores the previous state
+	void BeginRender(const Entry &entry);
+	void EndRender();
+
+	// Queues the entry as a quad with its top left at position
+	void Queue(const Entry &entry, glm::vec2 position);
+
+	// Draws everything queued, once per page, with the current
+	// shader. Returns the number of draw calls it took.
+	std::size_t Flush(const glm::mat4 &projection, Context &context);
+
+	// What the last Flush() streamed to the GPU
+	std::size_t GetFlushedBytes() const { return stream.size() * sizeof(float); }
+
+private:
+	struct Page {
+		Page(GLsizei size, int padding);
+
+		std::unique_ptr<FramebufferObject> framebuffer;
+		ShelfPacker packer;
+
+		uint64_t generation = 0;
+		uint64_t lastUsed = 0;
+
+		// Quads (x, y, u, v) waiting for Flush()
+		std::vector<float> vertices;
+	};
+
+	GLsizei pageSize = 2048;
+	std::size_t maxPages = 4;
+	int padding = 1;
+
+	std::vector<Page> pages;
+
+	uint64_t tick = 0;
+
+	VertexArray vao;
+	ArrayBuffer vbo;
+	std::vector<float> stream;
+
+	SavedRenderState oldState;
+};
+}
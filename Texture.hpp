@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include <glad/glad.h>
 
+#include "Buffer.hpp"
+
 namespace Fetcko {
 template<GLenum E>
 class Texture {
@@ -12,13 +18,27 @@ public:
 		other.handle = 0;
 		internalFormat = std::move(other.internalFormat);
 		format = std::move(other.format);
+		uploads = std::move(other.uploads);
+		uploadRingSize = other.uploadRingSize;
+		nextUpload = other.nextUpload;
 	}
 
 	Texture &operator=(Texture &&right) noexcept {
+		if (this == &right)
+			return *this;
+
+		// Whatever we held goes first
+		ClearUploads();
+		if (handle > 0)
+			glDeleteTextures(1, &handle);
+
 		handle = right.handle;
 		right.handle = 0;
 		internalFormat = right.internalFormat;
 		format = right.format;
+		uploads = std::move(right.uploads);
+		uploadRingSize = right.uploadRingSize;
+		nextUpload = right.nextUpload;
 
 		return *this;
 	}
@@ -30,10 +50,22 @@ public:
 		if (bind) Bind();
 	}
 	~Texture() {
+		ClearUploads();
+
 		if (handle > 0)
 			glDeleteTextures(1, &handle);
 	}
 
+	// How many levels a full mip chain for a width x height image has
+	static GLsizei GetMipLevels(GLsizei width, GLsizei height) {
+		GLsizei ret = 1;
+
+		for (auto size = std::max(width, height); size > 1; size /= 2)
+			++ret;
+
+		return ret;
+	}
+
 	void Bind() const {
 		glBindTexture(E, handle);
 	}
@@ -56,14 +88,145 @@ public:
 		);
 	}
 
+	// Allocates immutable storage for levels mip levels, which saves the
+	// driver from checking the texture for completeness on every use.
+	// Falls back to glTexImage2D for each level without
+	// GL_ARB_texture_storage (core since 4.2).
+	template<
+		GLenum _E = E,
+		typename std::enable_if_t<_E == GL_TEXTURE_2D, bool> * = nullptr
+	>
+	void TexStorage2D(GLsizei width, GLsizei height, GLsizei levels = 1) const {
+		levels = std::clamp(levels, 1, GetMipLevels(width, height));
+
+		if (GLAD_GL_ARB_texture_storage) {
+			glTexStorage2D(E, levels, GetSizedFormat(), width, height);
+			return;
+		}
+
+		for (GLint level = 0; level < levels; ++level) {
+			glTexImage2D(
+				E,
+				level,
+				GetSizedFormat(),
+				std::max(width >> level, 1),
+				std::max(height >> level, 1),
+				0,
+				format,
+				GL_UNSIGNED_BYTE,
+				nullptr
+			);
+		}
+
+		glTexParameteri(E, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+
+	// rowLength is the width (in pixels) of the image data
+	// is part of, when it's wider than the rectangle
+	void TexSubImage2D(GLint x, GLint y, GLsizei width, GLsizei height, const void *data, GLint rowLength = 0) const {
+		if (rowLength > 0)
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+
+		glTexSubImage2D(
+			E,
+			0,
+			x,
+			y,
+			width,
+			height,
+			format,
+			GL_UNSIGNED_BYTE,
+			data
+		);
+
+		if (rowLength > 0)
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+
+	// Same as TexSubImage2D(), but copies the pixels into a pixel unpack
+	// buffer for the driver to upload from whenever it gets to it, rather
+	// than making it copy them (or wait for the texture to be free) right
+	// away. The buffers are reused in turn, so this only ever waits when
+	// the GPU is a whole ring of uploads behind. Returns false if the
+	// buffer couldn't be mapped.
+	bool StreamSubImage2D(GLint x, GLint y, GLsizei width, GLsizei height, const void *data, GLint rowLength = 0) {
+		if (uploads.empty())
+			uploads.resize(uploadRingSize);
+
+		auto &upload = uploads[nextUpload++ % uploads.size()];
+
+		if (upload.fence) {
+			glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(upload.fence);
+			upload.fence = nullptr;
+		}
+
+		GLint alignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+
+		// Rows are packed as tightly as the unpack alignment allows
+		const auto rowSize = static_cast<std::size_t>(width) * GetBytesPerPixel();
+		const auto pitch = (rowSize + alignment - 1) / alignment * alignment;
+		const auto sourcePitch = rowLength > 0 ? static_cast<std::size_t>(rowLength) * GetBytesPerPixel() : pitch;
+		const auto size = pitch * height;
+
+		upload.buffer.Bind();
+
+		if (upload.capacity < size) {
+			upload.buffer.BufferData(size, GL_STREAM_DRAW);
+			upload.capacity = size;
+		}
+
+		// The fence already told us the GPU is done with it
+		auto mapped = upload.buffer.MapBufferRangeWritable(
+			0,
+			size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+		);
+
+		if (!mapped) {
+			upload.buffer.Unbind();
+			return false;
+		}
+
+		const auto source = static_cast<const uint8_t *>(data);
+		for (GLsizei row = 0; row < height; ++row)
+			std::memcpy(mapped + row * pitch, source + row * sourcePitch, rowSize);
+
+		if (!upload.buffer.UnmapBuffer()) {
+			upload.buffer.Unbind();
+			return false;
+		}
+
+		// With a buffer bound, the pointer is an offset into it
+		TexSubImage2D(x, y, width, height, nullptr);
+
+		upload.buffer.Unbind();
+
+		upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		return true;
+	}
+
+	// How many uploads can be in flight at once
+	void SetUploadRingSize(std::size_t size) {
+		ClearUploads();
+		uploadRingSize = std::max<std::size_t>(size, 1);
+	}
+
+	// Fills in every level below the first from it
+	void GenerateMipmap() const {
+		glGenerateMipmap(E);
+	}
+
 	template<
 		GLenum _E = E,
 		typename std::enable_if_t<_E == GL_TEXTURE_2D_MULTISAMPLE, bool> * = nullptr
 	>
-	void TexImage2DMultisample(GLsizei width, GLsizei height) const {
+	void TexImage2DMultisample(GLsizei width, GLsizei height, GLsizei samples = 4) const {
 		glTexImage2DMultisample(
 			E,
-			4,
+			samples,
 			internalFormat,
 			width,
 			height,
@@ -82,13 +245,64 @@ public:
 		glTexParameteri(E, GL_TEXTURE_MAG_FILTER, filterParam);
 	}
 
+	// For the mipmapped filters, which only work for minification
+	template<
+		GLenum _E = E,
+		typename std::enable_if_t<_E == GL_TEXTURE_2D, bool> * = nullptr
+	>
+	void SetMinFilter(GLint filterParam = GL_LINEAR_MIPMAP_LINEAR) const {
+		glTexParameteri(E, GL_TEXTURE_MIN_FILTER, filterParam);
+	}
+
 	const GLuint &GetHandle() const { return handle; }
 
 private:
+	// Texture storage needs the size of every channel spelled out
+	GLenum GetSizedFormat() const {
+		switch (internalFormat) {
+		case GL_RED: return GL_R8;
+		case GL_RG: return GL_RG8;
+		case GL_RGB: return GL_RGB8;
+		case GL_RGBA: return GL_RGBA8;
+		default: return static_cast<GLenum>(internalFormat);
+		}
+	}
+
+	std::size_t GetBytesPerPixel() const {
+		switch (format) {
+		case GL_RED: return 1;
+		case GL_RG: return 2;
+		case GL_RGB:
+		case GL_BGR: return 3;
+		default: return 4;
+		}
+	}
+
+	// Deletes the ring's fences along with its buffers
+	void ClearUploads() {
+		for (auto &upload : uploads) {
+			if (upload.fence)
+				glDeleteSync(upload.fence);
+		}
+
+		uploads.clear();
+		nextUpload = 0;
+	}
+
 	GLuint handle = 0;
 
 	GLint internalFormat = GL_RGBA;
 	GLenum format = GL_RGBA;
+
+	struct Upload {
+		PixelUnpackBuffer buffer;
+		GLsync fence = nullptr;
+		std::size_t capacity = 0;
+	};
+
+	std::vector<Upload> uploads;
+	std::size_t uploadRingSize = 3;
+	std::size_t nextUpload = 0;
 };
 
 using Texture2D = Texture<GL_TEXTURE_2D>;
@@ -0,0 +1,179 @@
+#include "TextureLoader.hpp"
+
+#include <exception>
+
+#include <lodepng.h>
+
+namespace Fetcko {
+TextureLoader::TextureLoader(std::size_t bytesPerFrame, bool mipmaps, std::size_t workers) :
+	bytesPerFrame(bytesPerFrame),
+	mipmaps(mipmaps),
+	pool(workers) {
+
+}
+
+TextureLoader::~TextureLoader() {
+	// The pool still runs what's queued, which can skip the decoding
+	stopping = true;
+}
+
+std::shared_ptr<TextureLoader::Handle> TextureLoader::Load(const std::filesystem::path &path) {
+	auto &existing = handles[path];
+
+	if (auto ret = existing.lock())
+		return ret;
+
+	// Forget about handles nobody wants anymore while we're at it
+	for (auto iter = handles.begin(); iter != handles.end(); ) {
+		if (iter->second.expired() && &iter->second != &existing)
+			iter = handles.erase(iter);
+		else
+			++iter;
+	}
+
+	auto ret = std::make_shared<Handle>();
+	ret->path = path;
+
+	existing = ret;
+	++pending;
+
+	pool.Submit([this, weakHandle = std::weak_ptr<Handle>(ret)] { Decode(weakHandle); });
+
+	return ret;
+}
+
+std::size_t TextureLoader::Update() {
+	std::size_t ret = 0;
+	std::size_t budget = bytesPerFrame;
+
+	while (true) {
+		Decoded *current = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// Cancelled loads aren't worth uploading
+			while (!decoded.empty() && decoded.front().handle.use_count() == 1) {
+				decoded.pop_front();
+				--pending;
+			}
+
+			if (decoded.empty())
+				break;
+
+			// Only Update() ever removes from the front
+			current = &decoded.front();
+		}
+
+		auto &handle = *current->handle;
+		const auto stride = static_cast<std::size_t>(handle.width) * 4;
+
+		// Rows we can afford, but always at least one to keep moving
+		const auto rows = std::min<GLsizei>(
+			handle.height - current->uploadedRows,
+			static_cast<GLsizei>(std::max<std::size_t>(budget / stride, 1))
+		);
+
+		// Anything goes for the first upload of the frame, so that a small
+		// budget can't keep an image from ever starting
+		if (current->uploadedRows > 0 || budget >= stride || budget == bytesPerFrame) {
+			if (!handle.texture) {
+				handle.texture = std::make_unique<Texture2D>(GL_RGBA, GL_RGBA, true);
+				handle.texture->TexStorage2D(
+					handle.width,
+					handle.height,
+					mipmaps ? Texture2D::GetMipLevels(handle.width, handle.height) : 1
+				);
+				handle.texture->SetTexParameters();
+
+				if (mipmaps)
+					handle.texture->SetMinFilter();
+			} else {
+				handle.texture->Bind();
+			}
+
+			handle.texture->TexSubImage2D(
+				0,
+				current->uploadedRows,
+				handle.width,
+				rows,
+				current->pixels.data() + current->uploadedRows * stride
+			);
+
+			current->uploadedRows += rows;
+			budget -= std::min(budget, rows * stride);
+
+			if (current->uploadedRows == handle.height && mipmaps)
+				handle.texture->GenerateMipmap();
+
+			handle.texture->Unbind();
+		} else {
+			// Starting an image costs at least a row, which we don't have left
+			break;
+		}
+
+		if (current->uploadedRows < handle.height)
+			break;
+
+		handle.state = State::Ready;
+		++ret;
+		--pending;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.pop_front();
+		}
+
+		if (budget == 0)
+			break;
+	}
+
+	return ret;
+}
+
+void TextureLoader::OnDestroy() {
+	stopping = true;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	pending -= decoded.size();
+	decoded.clear();
+
+	for (auto &[path, weakHandle] : handles) {
+		if (auto handle = weakHandle.lock())
+			handle->texture.reset();
+	}
+}
+
+void TextureLoader::Decode(const std::weak_ptr<Handle> &weakHandle) {
+	auto handle = weakHandle.lock();
+
+	if (!handle || stopping) {
+		--pending;
+		return;
+	}
+
+	// The pool drops our future, so nobody would hear about anything
+	// thrown (e.g. running out of memory on a huge image)
+	try {
+		std::vector<uint8_t> pixels;
+		unsigned width = 0, height = 0;
+
+		if (auto error = lodepng::decode(pixels, width, height, handle->path.u8string()); error || width == 0 || height == 0) {
+			logger.LogError("Could not load ", handle->path.u8string(), ": ", lodepng_error_text(error));
+			handle->state = State::Failed;
+			--pending;
+			return;
+		}
+
+		handle->width = static_cast<GLsizei>(width);
+		handle->height = static_cast<GLsizei>(height);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.emplace_back(Decoded{ handle, std::move(pixels) });
+	} catch (const std::exception &exception) {
+		logger.LogError("Could not load ", handle->path.u8string(), ": ", exception.what());
+		handle->state = State::Failed;
+		--pending;
+	}
+}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+
+namespace Fetcko {
+// Loads PNGs into textures without holding up the render thread: images
+// get decoded by a pool of workers, and Update() (called once a frame on
+// the GL thread) uploads them a slice of rows at a time, within a budget
+// of bytes per frame. What Load() returns becomes ready once the last
+// row is uploaded.
+//
+// Rows go in as the PNG stores them, top row first.
+class TextureLoader : public LoggableClass {
+public:
+	enum class State {
+		Pending,
+		Ready,
+		Failed
+	};
+
+	class Handle {
+	public:
+		// Safe to call from any thread
+		State GetState() const { return state; }
+		bool IsReady() const { return state == State::Ready; }
+
+		// Only on the GL thread, and only once ready
+		Texture2D *GetTexture() const { return IsReady() ? texture.get() : nullptr; }
+
+		// 0 until ready, as they're set by whichever worker decodes
+		GLsizei GetWidth() const { return IsReady() ? width : 0; }
+		GLsizei GetHeight() const { return IsReady() ? height : 0; }
+		const std::filesystem::path &GetPath() const { return path; }
+
+	private:
+		friend class TextureLoader;
+
+		std::filesystem::path path;
+		std::atomic<State> state{ State::Pending };
+
+		// Set once decoded, handed over to the GL thread
+		// through the decoded queue's mutex
+		GLsizei width = 0;
+		GLsizei height = 0;
+
+		std::unique_ptr<Texture2D> texture;
+	};
+
+	explicit TextureLoader(
+		std::size_t bytesPerFrame = 4 * 1024 * 1024,
+		bool mipmaps = false,
+		std::size_t workers = std::min(std::thread::hardware_concurrency(), 4u)
+	);
+
+	// Stops decoding whatever hasn't been started yet
+	~TextureLoader();
+
+	// Loading the same path again gives back the same handle, for
+	// as long as someone holds on to it. Dropping every reference to
+	// a handle cancels its load.
+	std::shared_ptr<Handle> Load(const std::filesystem::path &path);
+
+	// Uploads decoded images until the frame's budget runs out (finishing
+	// the upload in progress takes at least a row). Returns how many
+	// textures became ready.
+	std::size_t Update();
+
+	// Everything GL related has to go before the context does
+	void OnDestroy();
+
+	// Loads that aren't ready or failed yet
+	std::size_t GetPendingCount() const { return pending; }
+
+	void SetBytesPerFrame(std::size_t bytesPerFrame) { this->bytesPerFrame = bytesPerFrame; }
+
+private:
+	struct Decoded {
+		std::shared_ptr<Handle> handle;
+		std::vector<uint8_t> pixels;
+		GLsizei uploadedRows = 0;
+	};
+
+	void Decode(const std::weak_ptr<Handle> &weakHandle);
+
+	std::size_t bytesPerFrame;
+	bool mipmaps;
+
+	std::map<std::filesystem::path, std::weak_ptr<Handle>> handles;
+
+	// Filled by the workers, emptied by Update()
+	std::deque<Decoded> decoded;
+	std::mutex mutex;
+
+	std::atomic<std::size_t> pending{ 0 };
+	std::atomic<bool> stopping{ false };
+
+	// Last, so that its workers are gone before anything they use
+	ThreadPool pool;
+};
+}
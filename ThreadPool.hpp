@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Fetcko {
+// Fixed set of worker threads pulling tasks off a shared queue.
+// Tasks still queued when the pool is destroyed are run first.
+class ThreadPool {
+public:
+	explicit ThreadPool(std::size_t threadCount = std::thread::hardware_concurrency()) {
+		// hardware_concurrency() may not be able to tell
+		threadCount = std::max<std::size_t>(threadCount, 1);
+
+		for (std::size_t i = 0; i < threadCount; ++i)
+			threads.emplace_back([this] { Run(); });
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		condition.notify_all();
+
+		for (auto &thread : threads)
+			thread.join();
+	}
+
+	// Exceptions thrown by the task end up in the future
+	template<typename Function>
+	auto Submit(Function &&function) {
+		using Result = std::invoke_result_t<std::decay_t<Function>>;
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+		auto ret = task->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.emplace([task] { (*task)(); });
+		}
+
+		condition.notify_one();
+
+		return ret;
+	}
+
+	const std::size_t GetThreadCount() const { return threads.size(); }
+
+private:
+	void Run() {
+		while (true) {
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+				if (tasks.empty())
+					return;
+
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+
+			task();
+		}
+	}
+
+	std::vector<std::thread> threads;
+
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	bool stopping = false;
+};
+}
@@ -0,0 +1,360 @@
+#include "TiledExport.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <lodepng.h>
+
+#include "PixelConversion.hpp"
+#include "SavedRenderState.hpp"
+
+namespace Fetcko {
+// Takes the image a strip at a time, in whichever order the format stores its rows
+class TiledExport::Writer {
+public:
+	virtual ~Writer() = default;
+
+	virtual bool IsOpen() const = 0;
+	virtual bool IsBottomUp() const = 0;
+
+	// rgba holds rows of width pixels, bottom row first
+	virtual void WriteStrip(const uint8_t *rgba, GLsizei rows) = 0;
+
+	virtual bool Finish() = 0;
+};
+
+class TiledExport::BmpWriter : public TiledExport::Writer {
+public:
+	BmpWriter(const std::filesystem::path &path, GLsizei width, GLsizei height) :
+		outFile(path, std::ios::binary | std::ios::out),
+		width(width),
+		row(PixelConversion::GetPitch(width), 0) {
+		BMPHeader header;
+		header.offset = sizeof(BMPHeader) + sizeof(BITMAPINFOHEADER);
+		header.size = static_cast<uint32_t>(row.size() * height + header.offset);
+
+		BITMAPINFOHEADER infoHeader;
+		infoHeader.width = width;
+		infoHeader.height = height;
+
+		outFile.write(reinterpret_cast<const char *>(&header), sizeof(BMPHeader));
+		outFile.write(reinterpret_cast<const char *>(&infoHeader), sizeof(BITMAPINFOHEADER));
+	}
+
+	bool IsOpen() const override { return outFile.is_open(); }
+	bool IsBottomUp() const override { return true; }
+
+	void WriteStrip(const uint8_t *rgba, GLsizei rows) override {
+		for (GLsizei y = 0; y < rows; ++y) {
+			PixelConversion::ConvertRow(rgba + static_cast<std::size_t>(y) * width * 4, width, PixelConversion::Order::Bgr, row.data());
+			outFile.write(reinterpret_cast<const char *>(row.data()), row.size());
+		}
+	}
+
+	bool Finish() override {
+		outFile.close();
+		return static_cast<bool>(outFile);
+	}
+
+private:
+	std::ofstream outFile;
+	std::size_t width;
+
+	// Padding stays zeroed, since only the pixels get overwritten
+	std::vector<uint8_t> row;
+};
+
+// Writes the pixel data as a zlib stream of stored blocks, which needs
+// nothing but a running Adler-32, with an IDAT chunk per strip
+class TiledExport::PngWriter : public TiledExport::Writer {
+public:
+	PngWriter(const std::filesystem::path &path, GLsizei width, GLsizei height) :
+		outFile(path, std::ios::binary | std::ios::out),
+		width(width) {
+		static constexpr uint8_t Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		outFile.write(reinterpret_cast<const char *>(Signature), sizeof(Signature));
+
+		std::vector<uint8_t> header;
+		WriteBigEndian(header, static_cast<uint32_t>(width));
+		WriteBigEndian(header, static_cast<uint32_t>(height));
+		header.insert(header.end(), {
+			8,	// Bits per channel
+			6,	// RGBA
+			0,	// Deflate
+			0,	// Adaptive filtering (we always pick none)
+			0	// Not interlaced
+		});
+		WriteChunk("IHDR", header);
+
+		// Deflate with a 32K window, no dictionary, fastest
+		data.insert(data.end(), { 0x78, 0x01 });
+	}
+
+	bool IsOpen() const override { return outFile.is_open(); }
+	bool IsBottomUp() const override { return false; }
+
+	void WriteStrip(const uint8_t *rgba, GLsizei rows) override {
+		const auto stride = static_cast<std::size_t>(width) * 4;
+
+		for (auto y = rows; y-- > 0; ) {
+			const uint8_t filter = 0;
+			Append(&filter, 1);
+			Append(rgba + y * stride, stride);
+		}
+
+		WriteChunk("IDAT", data);
+		data.clear();
+	}
+
+	bool Finish() override {
+		// Whatever is left (possibly nothing) makes the final block
+		WriteBlock(pending.data(), pending.size(), true);
+		pending.clear();
+
+		WriteBigEndian(data, (adlerB << 16) | adlerA);
+		WriteChunk("IDAT", data);
+		WriteChunk("IEND", {});
+
+		outFile.close();
+		return static_cast<bool>(outFile);
+	}
+
+private:
+	static constexpr std::size_t MaxBlockSize = 65535;
+
+	static void WriteBigEndian(std::vector<uint8_t> &output, uint32_t value) {
+		output.push_back(static_cast<uint8_t>(value >> 24));
+		output.push_back(static_cast<uint8_t>(value >> 16));
+		output.push_back(static_cast<uint8_t>(value >> 8));
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	void Append(const uint8_t *bytes, std::size_t size) {
+		// Sums can go 5552 bytes before they could overflow
+		for (std::size_t offset = 0; offset < size; ) {
+			const auto count = std::min<std::size_t>(size - offset, 5552);
+
+			for (std::size_t i = 0; i < count; ++i) {
+				adlerA += bytes[offset + i];
+				adlerB += adlerA;
+			}
+
+			adlerA %= 65521;
+			adlerB %= 65521;
+			offset += count;
+		}
+
+		while (size > 0) {
+			const auto count = std::min(size, MaxBlockSize - pending.size());
+
+			pending.insert(pending.end(), bytes, bytes + count);
+			bytes += count;
+			size -= count;
+
+			if (pending.size() == MaxBlockSize) {
+				WriteBlock(pending.data(), pending.size(), false);
+				pending.clear();
+			}
+		}
+	}
+
+	void WriteBlock(const uint8_t *bytes, std::size_t size, bool final) {
+		const auto length = static_cast<uint16_t>(size);
+
+		data.insert(data.end(), {
+			static_cast<uint8_t>(final ? 1 : 0),
+			static_cast<uint8_t>(length),
+			static_cast<uint8_t>(length >> 8),
+			static_cast<uint8_t>(~length),
+			static_cast<uint8_t>(~length >> 8)
+		});
+		data.insert(data.end(), bytes, bytes + size);
+	}
+
+	void WriteChunk(const char *type, const std::vector<uint8_t> &contents) {
+		std::vector<uint8_t> chunk;
+		chunk.reserve(contents.size() + 12);
+
+		WriteBigEndian(chunk, static_cast<uint32_t>(contents.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), contents.begin(), contents.end());
+
+		// Covers the type and the contents, not the length
+		WriteBigEndian(chunk, lodepng_crc32(chunk.data() + 4, chunk.size() - 4));
+
+		outFile.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+	}
+
+	std::ofstream outFile;
+	GLsizei width;
+
+	// The zlib stream that goes into the next IDAT chunk
+	std::vector<uint8_t> data;
+
+	// Bytes that don't make up a full block yet
+	std::vector<uint8_t> pending;
+
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+};
+
+TiledExport::TiledExport(GLsizei tileSize) : tileSize(tileSize) {
+
+}
+
+bool TiledExport::Export(
+	const std::filesystem::path &path,
+	GLsizei width,
+	GLsizei height,
+	Context &context,
+	const Render &render,
+	const glm::vec4 &background
+) {
+	auto extension = path.extension().u8string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+	return Export(path, extension == ".png" ? Format::Png : Format::Bmp, width, height, context, render, background);
+}
+
+bool TiledExport::Export(
+	const std::filesystem::path &path,
+	Format format,
+	GLsizei width,
+	GLsizei height,
+	Context &context,
+	const Render &render,
+	const glm::vec4 &background
+) {
+	if (width <= 0 || height <= 0) {
+		logger.LogError("Invalid image size ", width, "x", height);
+		return false;
+	}
+
+	if (format == Format::Bmp &&
+		PixelConversion::GetPitch(width) * height + sizeof(BMPHeader) + sizeof(BITMAPINFOHEADER) > std::numeric_limits<uint32_t>::max()) {
+		logger.LogError(width, "x", height, " is too big for a BMP");
+		return false;
+	}
+
+	GLint maxTextureSize = 0;
+	GLint maxViewport[2] = { 0, 0 };
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+
+	const auto size = std::min({ tileSize, maxTextureSize, maxViewport[0], maxViewport[1] });
+
+	std::unique_ptr<Writer> writer;
+	if (format == Format::Png)
+		writer = std::make_unique<PngWriter>(path, width, height);
+	else
+		writer = std::make_unique<BmpWriter>(path, width, height);
+
+	// Rather than finding out after rendering the whole image
+	if (!writer->IsOpen()) {
+		logger.LogError("Could not open ", path.u8string(), " for writing");
+		return false;
+	}
+
+	// Saved before creating the tile, which binds framebuffer 0
+	SavedRenderState oldState;
+	oldState.Save();
+
+	GLint oldPackAlignment = 0;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &oldPackAlignment);
+
+	if (!tile || tile->GetWidth() != size)
+		tile = std::make_unique<FramebufferObject>(size, size);
+
+	// Each tile sets its own
+	const auto oldIdentity = context.GetIdentity();
+	const auto oldProjection = context.GetProjection();
+
+	// The caller's scissor box would cut into the tiles' clears
+	glDisable(GL_SCISSOR_TEST);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	const auto strips = (height + size - 1) / size;
+
+	for (GLsizei i = 0; i < strips; ++i) {
+		// Strips start at the top of the image, the last one may be short
+		const auto top = (writer->IsBottomUp() ? strips - 1 - i : i) * size;
+		const auto rows = std::min(size, height - top);
+
+		RenderStrip(width, top, rows, context, render, background);
+		writer->WriteStrip(strip.data(), rows);
+	}
+
+	oldState.Restore();
+	glPixelStorei(GL_PACK_ALIGNMENT, oldPackAlignment);
+
+	context.SetIdentity(glm::mat4(oldIdentity));
+	context.SetProjection(glm::mat4(oldProjection));
+
+	// A whole strip can be a lot of memory
+	strip = {};
+	tilePixels = {};
+
+	if (!writer->Finish()) {
+		logger.LogError("Could not write ", path.u8string());
+		return false;
+	}
+
+	return true;
+}
+
+void TiledExport::OnDestroy() {
+	tile.reset();
+}
+
+void TiledExport::RenderStrip(
+	GLsizei width,
+	GLsizei top,
+	GLsizei rows,
+	Context &context,
+	const Render &render,
+	const glm::vec4 &background
+) {
+	const auto size = tile->GetWidth();
+	const auto stride = static_cast<std::size_t>(width) * 4;
+
+	strip.resize(stride * rows);
+	tilePixels.resize(static_cast<std::size_t>(size) * rows * 4);
+
+	for (GLsizei left = 0; left < width; left += size) {
+		const auto columns = std::min(size, width - left);
+
+		tile->Bind();
+		glViewport(0, 0, columns, rows);
+
+		glClearColor(background.x, background.y, background.z, background.w);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		const auto projection = glm::ortho(
+			static_cast<float>(left),
+			static_cast<float>(left + columns),
+			static_cast<float>(top + rows),
+			static_cast<float>(top)
+		);
+
+		context.SetIdentity(glm::mat4(projection));
+		render(context, projection);
+
+		// Rendering may have bound something else
+		tile->Bind();
+		glReadPixels(0, 0, columns, rows, GL_RGBA, GL_UNSIGNED_BYTE, tilePixels.data());
+
+		for (GLsizei y = 0; y < rows; ++y) {
+			std::memcpy(
+				strip.data() + y * stride + static_cast<std::size_t>(left) * 4,
+				tilePixels.data() + static_cast<std::size_t>(y) * columns * 4,
+				static_cast<std::size_t>(columns) * 4
+			);
+		}
+	}
+}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Context.hpp"
+#include "Framebuffer.hpp"
+#include "Logger.hpp"
+
+namespace Fetcko {
+// Renders images bigger than a framebuffer can be (or than we'd like to
+// keep in memory) one tile at a time, each with a projection covering
+// just its part of the image. A strip of tiles gets read back and its
+// rows written to the file before the next is rendered, so only one
+// strip ever sits in memory.
+//
+// PNGs are written without compression (stored deflate blocks), as
+// lodepng can't compress a stream piece by piece.
+class TiledExport : public LoggableClass {
+public:
+	enum class Format {
+		Bmp,
+		Png
+	};
+
+	// Draws the scene. The projection maps image pixels, with the
+	// origin at the top left, and is also the context's identity.
+	using Render = std::function<void(Context &context, const glm::mat4 &projection)>;
+
+	// Tiles are clamped to what the driver supports
+	explicit TiledExport(GLsizei tileSize = 2048);
+
+	// Puts back the framebuffers, viewport, scissor test, clear color,
+	// pack alignment and context matrices it found, whatever happens
+	bool Export(
+		const std::filesystem::path &path,
+		Format format,
+		GLsizei width,
+		GLsizei height,
+		Context &context,
+		const Render &render,
+		const glm::vec4 &background = glm::vec4(0.0f)
+	);
+
+	// Goes by the extension, anything but .png is a BMP
+	bool Export(
+		const std::filesystem::path &path,
+		GLsizei width,
+		GLsizei height,
+		Context &context,
+		const Render &render,
+		const glm::vec4 &background = glm::vec4(0.0f)
+	);
+
+	// Frees the tile's framebuffer until the next export
+	void OnDestroy();
+
+private:
+	class Writer;
+	class BmpWriter;
+	class PngWriter;
+
+	// Renders the strip of tiles covering rows [top, top + rows) of the
+	// image into strip, bottom row first (as OpenGL reads them back)
+	void RenderStrip(
+		GLsizei width,
+		GLsizei top,
+		GLsizei rows,
+		Context &context,
+		const Render &render,
+		const glm::vec4 &background
+	);
+
+	GLsizei tileSize;
+
+	std::unique_ptr<FramebufferObject> tile;
+
+	std::vector<uint8_t> strip;
+	std::vector<uint8_t> tilePixels;
+};
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+namespace Fetcko {
+// Non-allocating UTF-8 decoder, usable in range-based for loops:
+//
+//		for (const auto c : Utf8(text)) { ... }
+//
+// Malformed or truncated sequences decode to U+FFFD.
+class Utf8 {
+public:
+	static constexpr char32_t Replacement = 0xFFFD;
+
+	class Iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = char32_t;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const char32_t *;
+		using reference = char32_t;
+
+		Iterator() = default;
+		Iterator(const char *current, const char *end) :
+			current(current),
+			end(end) {
+			Decode();
+		}
+
+		char32_t operator*() const { return codePoint; }
+
+		Iterator &operator++() {
+			current = next;
+			Decode();
+			return *this;
+		}
+
+		// Start of the current code point in the string
+		const char *GetPointer() const { return current; }
+
+		bool operator==(const Iterator &right) const { return current == right.current; }
+		bool operator!=(const Iterator &right) const { return current != right.current; }
+
+	private:
+		inline void Decode() {
+			if (current == end)
+				return;
+
+			const auto lead = static_cast<uint8_t>(*current);
+			next = current + 1;
+
+			// Fast path for ASCII
+			if (lead < 0x80) {
+				codePoint = lead;
+				return;
+			}
+
+			int length = 0;
+			char32_t min = 0;
+
+			if ((lead & 0xE0) == 0xC0) {
+				length = 1;
+				min = 0x80;
+				codePoint = lead & 0x1F;
+			} else if ((lead & 0xF0) == 0xE0) {
+				length = 2;
+				min = 0x800;
+				codePoint = lead & 0x0F;
+			} else if ((lead & 0xF8) == 0xF0) {
+				length = 3;
+				min = 0x10000;
+				codePoint = lead & 0x07;
+			} else {
+				codePoint = Replacement;
+				return;
+			}
+
+			for (int i = 0; i < length; ++i, ++next) {
+				if (next == end || (static_cast<uint8_t>(*next) & 0xC0) != 0x80) {
+					codePoint = Replacement;
+					return;
+				}
+
+				codePoint = (codePoint << 6) | (static_cast<uint8_t>(*next) & 0x3F);
+			}
+
+			// Overlong encodings, surrogates and anything past U+10FFFF
+			if (codePoint < min || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+				codePoint = Replacement;
+		}
+
+		const char *current = nullptr;
+		const char *next = nullptr;
+		const char *end = nullptr;
+
+		char32_t codePoint = 0;
+	};
+
+	explicit Utf8(std::string_view string) : string(string) {}
+
+	Iterator begin() const { return Iterator(string.data(), string.data() + string.size()); }
+	Iterator end() const { return Iterator(string.data() + string.size(), string.data() + string.size()); }
+
+private:
+	std::string_view string;
+};
+}
@@ -0,0 +1,220 @@
+// Measures OpenGLFont throughput on a few representative workloads.
+// Runs through HeadlessContext, so it works under Mesa's llvmpipe:
+//
+//		LIBGL_ALWAYS_SOFTWARE=1 ./TextBenchmark /path/to/font.ttf [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Framebuffer.hpp"
+#include "Hash.hpp"
+#include "HeadlessContext.hpp"
+#include "OpenGLFont.hpp"
+#include "Utils.hpp"
+
+using namespace Fetcko;
+
+namespace {
+constexpr int Width = 1280;
+constexpr int Height = 720;
+
+bool AddShader(Context &context, const std::string &name, std::uint32_t hash) {
+	auto shader = context.AddShader(
+		std::string(BENCHMARK_SHADER_DIR) + "/" + name + ".vert",
+		std::string(BENCHMARK_SHADER_DIR) + "/" + name + ".frag",
+		hash
+	);
+
+	if (!shader)
+		return false;
+
+	shader->program.Use();
+	shader->program.CacheUniformLocation("projection");
+	shader->program.CacheUniformLocation("color");
+
+	return true;
+}
+
+void AppendUtf8(std::string &string, char32_t c) {
+	if (c < 0x80) {
+		string += static_cast<char>(c);
+	} else if (c < 0x800) {
+		string += static_cast<char>(0xC0 | (c >> 6));
+		string += static_cast<char>(0x80 | (c & 0x3F));
+	} else {
+		string += static_cast<char>(0xE0 | (c >> 12));
+		string += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+		string += static_cast<char>(0x80 | (c & 0x3F));
+	}
+}
+
+// Frames may cache text, which renders into atlas pages,
+// so the target gets bound again at the start of each one
+void BeginFrame(FramebufferObject &target) {
+	target.Bind();
+	glViewport(0, 0, Width, Height);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+// Runs frame() for the given number of frames into target
+// and reports per frame averages of the font's counters
+void Run(FramebufferObject &target, const char *name, OpenGLFont &font, int frames, const std::function<void(int)> &frame) {
+	// One untimed frame, so we measure the steady state
+	BeginFrame(target);
+	frame(-1);
+	glFinish();
+
+	font.ResetStatistics();
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < frames; ++i) {
+		BeginFrame(target);
+		frame(i);
+	}
+
+	glFinish();
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const auto statistics = font.GetStatistics();
+
+	std::printf(
+		"%-24s %9.3f ms/frame %12.0f glyphs/s %8.1f draws/frame %12.0f bytes/frame\n",
+		name,
+		seconds * 1000.0 / frames,
+		statistics.glyphs / seconds,
+		static_cast<double>(statistics.drawCalls) / frames,
+		static_cast<double>(statistics.bytesUploaded) / frames
+	);
+}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "Usage: %s <font.ttf> [frames]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const std::string fontPath = argv[1];
+	const int frames = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 500;
+
+	HeadlessContext headless;
+	if (!headless.Init()) {
+		std::fprintf(stderr, "Could not create an EGL context\n");
+		return EXIT_FAILURE;
+	}
+
+	std::printf("%s\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+
+	// Everything renders into this, there is no window to draw to
+	FramebufferObject target(Width, Height);
+
+	auto &context = headless.GetContext();
+	if (!AddShader(context, "texture", "texture"_hash) || !AddShader(context, "font", "font"_hash)) {
+		std::fprintf(stderr, "Could not load the shaders in %s\n", BENCHMARK_SHADER_DIR);
+		return EXIT_FAILURE;
+	}
+
+	const auto projection = glm::ortho(0.0f, static_cast<float>(Width), static_cast<float>(Height), 0.0f);
+	context.SetIdentity(glm::mat4(projection));
+	context.Use("texture"_hash);
+	context.Apply();
+
+	OpenGLFont plain;
+	OpenGLFont outlined;
+
+	if (!plain.OnInit(std::vector<std::string>{ fontPath }, 18) ||
+		!outlined.OnInit(std::vector<std::string>{ fontPath }, 18, 2)) {
+		std::fprintf(stderr, "Could not load %s\n", fontPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	const glm::vec3 white(1.0f);
+
+	std::vector<std::string> labels;
+	for (int i = 0; i < 40; ++i)
+		labels.emplace_back("Track " + std::to_string(i + 1) + " - Some Artist: A Fairly Long Title");
+
+	const auto labelFrame = [&](OpenGLFont &font) {
+		return [&font, &labels, &white, &projection, &context](int) {
+			for (const auto &[i, label] : Utils::Enumerate(labels))
+				font.QueueText(label, { 10.0f, 20.0f + i * 17.0f }, white);
+
+			font.FlushText(projection, context);
+		};
+	};
+
+	Run(target, "ascii labels", plain, frames, labelFrame(plain));
+	Run(target, "ascii labels (outline)", outlined, frames, labelFrame(outlined));
+
+	Run(target, "changing numbers", plain, frames, [&](int frame) {
+		for (int i = 0; i < 40; ++i) {
+			const auto value = std::to_string(frame * 40 + i) + " / " + std::to_string((frame * 7919 + i) % 100000);
+			plain.QueueText(value, { 10.0f, 20.0f + i * 17.0f }, white);
+		}
+
+		plain.FlushText(projection, context);
+	});
+
+	// New code points every frame, so every glyph goes through LoadMissingGlyph()
+	const std::vector<std::pair<char32_t, char32_t>> scripts = {
+		{ 0x0370, 0x03FF },	// Greek
+		{ 0x0400, 0x04FF },	// Cyrillic
+		{ 0x4E00, 0x9FFF }	// CJK
+	};
+
+	std::size_t script = 0;
+	char32_t next = scripts[0].first;
+
+	Run(target, "mixed script (missing)", plain, frames, [&](int) {
+		std::string text = "Mixed ";
+
+		for (int i = 0; i < 8; ++i) {
+			AppendUtf8(text, next);
+
+			if (++next > scripts[script].second) {
+				script = (script + 1) % scripts.size();
+				next = scripts[script].first;
+			}
+		}
+
+		plain.QueueText(text, { 10.0f, 20.0f }, white);
+		plain.FlushText(projection, context);
+	});
+
+	Run(target, "RenderText", plain, frames, [&](int) {
+		for (const auto &[i, label] : Utils::Enumerate(labels)) {
+			auto translated = glm::translate(projection, glm::vec3(10.0f, 20.0f + i * 17.0f, 0.0f));
+			plain.RenderText(label, translated, white, context);
+		}
+	});
+
+	std::vector<std::shared_ptr<OpenGLFont::CachedText>> cached;
+	for (const auto &label : labels)
+		cached.emplace_back(plain.CacheText(label, white, context).first);
+
+	Run(target, "CacheText", plain, frames, [&](int) {
+		context.Use("texture"_hash);
+
+		for (const auto &[i, text] : Utils::Enumerate(cached))
+			plain.QueueCached(text, { 10.0f, 20.0f + i * 17.0f - text->bounds.y }, context);
+
+		plain.FlushCached(projection, context);
+	});
+
+	outlined.OnDestroy();
+	plain.OnDestroy();
+
+	target.Unbind();
+
+	return EXIT_SUCCESS;
+}
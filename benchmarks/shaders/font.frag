@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 TexCoords;
+in vec3 Color;
+
+out vec4 FragColor;
+
+uniform sampler2D text;
+
+void main() {
+	FragColor = vec4(Color, texture(text, TexCoords).r);
+}
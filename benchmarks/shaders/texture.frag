@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D text;
+uniform vec4 color;
+
+void main() {
+	FragColor = texture(text, TexCoords);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Minimal stand-in for the application's "texture" shader
+
+layout (location = 0) in vec2 vertex;
+layout (location = 1) in vec2 texCoords;
+
+out vec2 TexCoords;
+
+uniform mat4 projection;
+
+// Picks the part of a framebuffer's texture its content covers
+uniform vec2 texCoordScale = vec2(1.0);
+
+void main() {
+	gl_Position = projection * vec4(vertex, 0.0, 1.0);
+	TexCoords = texCoords * texCoordScale;
+}
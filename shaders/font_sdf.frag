@@ -0,0 +1,23 @@
+#version 330 core
+
+in vec2 TexCoords;
+in vec3 Color;
+
+out vec4 FragColor;
+
+uniform sampler2D text;
+
+// Moves the edge out by this much of the field, for outlines
+uniform float outline;
+
+void main() {
+	// FreeType stores the signed distance around 0.5,
+	// with values above it being inside the glyph
+	float distance = texture(text, TexCoords).r - 0.5 + outline;
+
+	// Antialias over roughly one screen pixel, whatever the scale
+	float width = max(fwidth(distance), 1e-4);
+	float alpha = smoothstep(-width, width, distance);
+
+	FragColor = vec4(Color, alpha);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+// Pairs with font_sdf.frag for OpenGLFont::RenderMode::Sdf.
+// Register both under "font_sdf"_hash and cache the
+// "projection" uniform location. Colors come per vertex.
+
+layout (location = 0) in vec2 vertex;
+layout (location = 1) in vec2 texCoords;
+layout (location = 2) in vec3 color;
+
+out vec2 TexCoords;
+out vec3 Color;
+
+uniform mat4 projection;
+
+void main() {
+	gl_Position = projection * vec4(vertex, 0.0, 1.0);
+	TexCoords = texCoords;
+	Color = color;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+in vec2 Edge;
+
+out vec4 FragColor;
+
+uniform vec4 color;
+
+void main() {
+	float distance = abs(Edge.x);
+
+	// How much of this pixel the line covers, with
+	// the edge fading out over one screen pixel
+	float width = max(fwidth(Edge.x), 1e-4);
+	float coverage = clamp((Edge.y - distance) / width + 0.5, 0.0, 1.0);
+
+	FragColor = vec4(color.rgb, color.a * coverage);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Pairs with polyline_aa.frag for Polylines with a feather.
+// Register both under "polyline_aa"_hash and cache the
+// "projection" and "color" uniform locations.
+
+layout (location = 0) in vec2 vertex;
+layout (location = 1) in vec2 edge;
+
+// Signed distance from the center of the line, and half its width
+out vec2 Edge;
+
+uniform mat4 projection;
+
+void main() {
+	gl_Position = projection * vec4(vertex, 0.0, 1.0);
+	Edge = edge;
+}
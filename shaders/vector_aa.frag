@@ -0,0 +1,16 @@
+#version 330 core
+
+in float Edge;
+
+out vec4 FragColor;
+
+uniform vec4 color;
+
+void main() {
+	// How much of this pixel the shape covers, with the
+	// outline fading out over one screen pixel around it
+	float width = max(fwidth(Edge), 1e-4);
+	float coverage = clamp(Edge / width + 0.5, 0.0, 1.0);
+
+	FragColor = vec4(color.rgb, color.a * coverage);
+}
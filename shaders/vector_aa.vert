@@ -0,0 +1,17 @@
+#version 330 core
+
+// Pairs with vector_aa.frag for OpenGLVectors loaded with a feather.
+// Register both under "vector_aa"_hash and cache the
+// "projection" and "color" uniform locations.
+
+layout (location = 0) in vec2 vertex;
+layout (location = 1) in float edge;
+
+out float Edge;
+
+uniform mat4 projection;
+
+void main() {
+	gl_Position = projection * vec4(vertex, 0.0, 1.0);
+	Edge = edge;
+}